@@ -0,0 +1,775 @@
+//-------------------------------------------------------------------------------------------------------
+// Copyright (C) 2016 HHD Software Ltd.
+// Written by Alexander Bessonov
+//
+// Licensed under the MIT license. See LICENSE.txt file in the project root for full license information.
+//-------------------------------------------------------------------------------------------------------
+
+// Drives representative script workloads at fixed request rates on 1..N runtimes, one runtime per thread, and prints
+// throughput, latency percentiles and working set growth of each run as a JSON line. With --profile, every runtime is
+// sampled by the profiler. --profile is only available when built with CBRIDGE_PROFILER (msbuild /p:Profiler=true),
+// so that runs without it, built without the define, show the profiler's full overhead.
+// --self-test checks the string transcoders against std::codecvt and exits
+
+#define NOMINMAX
+#include <windows.h>
+#include <psapi.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <codecvt>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <locale>
+#include <memory>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <chakra_bridge/chakra_bridge.h>
+#pragma comment(lib,"ChakraCore")
+#pragma comment(lib,"psapi")
+#pragma comment(lib,"winmm")
+
+using clock_type = std::chrono::steady_clock;
+
+// Workload is created once per runtime, with the runtime's context current, and then executes requests
+class workload
+{
+public:
+	virtual ~workload() = default;
+	virtual void run() = 0;
+};
+
+// Parse a JSON document of orders, aggregate them per customer and serialize the result
+class json_transform : public workload
+{
+	jsc::referenced_value transform;
+	std::wstring input;
+
+public:
+	json_transform()
+	{
+		transform = jsc::RunScript(LR"==((function (text) {
+	var orders = JSON.parse(text), totals = {};
+	orders.forEach(function (o) {
+		if (o.status !== "cancelled") {
+			var t = totals[o.customer] || (totals[o.customer] = { customer: o.customer, count: 0, amount: 0 });
+			t.count++;
+			t.amount += o.quantity * o.price;
+		}
+	});
+	return JSON.stringify(Object.keys(totals).map(function (k) { return totals[k]; }).sort(function (a, b) { return b.amount - a.amount; }));
+}))==", JS_SOURCE_CONTEXT_NONE, L"");
+
+		input = L"[";
+		for (int i = 0; i < 200; ++i)
+		{
+			if (i)
+				input += L',';
+			input += L"{\"id\":" + std::to_wstring(i) +
+				L",\"customer\":\"customer" + std::to_wstring(i % 17) +
+				L"\",\"status\":\"" + (i % 7 ? L"shipped" : L"cancelled") +
+				L"\",\"quantity\":" + std::to_wstring(i % 5 + 1) +
+				L",\"price\":" + std::to_wstring(i * 0.25 + 1) + L'}';
+		}
+		input += L']';
+	}
+
+	void run() override
+	{
+		auto result = transform(nullptr, input).as_string();
+		if (result.empty())
+			throw std::runtime_error("empty result");
+	}
+};
+
+// Render a page from a template compiled once, with data built by the host for every request
+class template_render : public workload
+{
+	jsc::referenced_value render;
+	unsigned int request{ 0 };
+
+public:
+	template_render()
+	{
+		auto compile = jsc::RunScript(LR"==((function (text) {
+	var parts = text.split(/\{\{|\}\}/), code = "var out = '';";
+	for (var i = 0; i < parts.length; ++i) {
+		var p = parts[i];
+		if (i % 2 === 0)
+			code += "out += " + JSON.stringify(p) + ";";
+		else if (p.charAt(0) === "#")
+			code += "d.stack.push(d.it); for (var k = 0, a = d.it." + p.substring(1) + "; k < a.length; ++k) { d.it = a[k];";
+		else if (p.charAt(0) === "/")
+			code += "} d.it = d.stack.pop();";
+		else
+			code += "out += String(d.it." + p + ").replace(/[&<>]/g, function (c) { return c === '&' ? '&amp;' : c === '<' ? '&lt;' : '&gt;'; });";
+	}
+	var body = new Function("d", code + "return out;");
+	return function (data) { return body({ it: data, stack: [] }); };
+}))==", JS_SOURCE_CONTEXT_NONE, L"");
+
+		render = compile(nullptr, L"<h1>{{title}}</h1><p>{{user}} has {{count}} items</p><ul>{{#items}}<li>{{name}} &mdash; {{price}}</li>{{/items}}</ul>");
+	}
+
+	void run() override
+	{
+		auto items = jsc::value::uninitialized_array(20);
+		for (int i = 0; i < 20; ++i)
+		{
+			items.set_indexed(i, jsc::value::object()
+				.field(L"name", L"item <" + std::to_wstring(i) + L'>')
+				.field(L"price", 9.99 + i));
+		}
+
+		++request;
+		auto data = jsc::value::object()
+			.field(L"title", L"Order history")
+			.field(L"user", L"user" + std::to_wstring(request % 100))
+			.field(L"count", 20)
+			.field(L"items", items);
+		auto page = render(nullptr, data).as_string();
+		if (page.empty())
+			throw std::runtime_error("empty page");
+	}
+};
+
+// Evaluate a set of rules against a record owned by the host. Rules read fields and report matches through native
+// callbacks, so the cost is dominated by transitions between script and host
+class rules_engine : public workload
+{
+	struct record
+	{
+		double amount;
+		double age;
+		double score;
+		std::wstring country;
+	};
+
+	jsc::referenced_value evaluate;
+	record current{};
+	unsigned int request{ 0 };
+	double total{ 0 };
+
+public:
+	rules_engine()
+	{
+		auto host = jsc::value::object()
+			.method<1>(L"number", [this](const std::wstring &name)
+		{
+			return name == L"amount" ? current.amount : name == L"age" ? current.age : current.score;
+		})
+			.method<0>(L"country", [this]
+		{
+			return current.country;
+		})
+			.method<2>(L"emit", [this](int rule, double weight)
+		{
+			total += rule * weight;
+		});
+
+		auto create = jsc::RunScript(LR"==((function (host) {
+	var rules = [], fields = ["amount", "age", "score"], countries = ["US", "DE", "FR", "JP"];
+	for (var i = 0; i < 40; ++i)
+		rules.push({ id: i, field: fields[i % 3], limit: i * 25, country: countries[i % 4], weight: 1 + i % 3 });
+	return function () {
+		var matched = 0;
+		for (var i = 0; i < rules.length; ++i) {
+			var r = rules[i];
+			if (host.number(r.field) > r.limit && (i % 2 === 0 || host.country() === r.country)) {
+				host.emit(r.id, r.weight);
+				++matched;
+			}
+		}
+		return matched;
+	};
+}))==", JS_SOURCE_CONTEXT_NONE, L"");
+
+		evaluate = create(nullptr, host);
+	}
+
+	void run() override
+	{
+		static const wchar_t *countries[] = { L"US", L"DE", L"FR", L"JP", L"UK" };
+		++request;
+		current = { static_cast<double>(request % 1000), static_cast<double>(request % 90), static_cast<double>(request % 500), countries[request % 5] };
+		evaluate(nullptr);
+	}
+};
+
+// Numeric kernel over typed arrays sharing host memory: y = a * x + y / 2 followed by a dot product
+class typed_array_kernel : public workload
+{
+	static const unsigned int size = 64 * 1024;
+
+	std::vector<double> x, y;
+	jsc::referenced_value kernel;
+	jsc::referenced_value x_js, y_js;
+
+public:
+	typed_array_kernel() :
+		x(size),
+		y(size)
+	{
+		for (unsigned int i = 0; i < size; ++i)
+		{
+			x[i] = i * 0.001;
+			y[i] = 1.0;
+		}
+
+		kernel = jsc::RunScript(LR"==((function (a, x, y) {
+	var dot = 0;
+	for (var i = 0, n = x.length; i < n; ++i) {
+		y[i] = a * x[i] + y[i] * 0.5;
+		dot += x[i] * y[i];
+	}
+	return dot;
+}))==", JS_SOURCE_CONTEXT_NONE, L"");
+
+		x_js = jsc::value::typed_array(JsArrayTypeFloat64, jsc::value::array_buffer(x.data(), x.size() * sizeof(double)), 0, size);
+		y_js = jsc::value::typed_array(JsArrayTypeFloat64, jsc::value::array_buffer(y.data(), y.size() * sizeof(double)), 0, size);
+	}
+
+	void run() override
+	{
+		kernel(nullptr, 0.5, x_js, y_js).as_double();
+	}
+};
+
+// Call a native function from a tight script loop, so latency is dominated by the cost of a single callback. The
+// noexcept variant takes and returns values only, so it goes through the dispatcher without exception handlers
+template<bool NoExcept>
+class native_calls : public workload
+{
+	jsc::referenced_value loop;
+	double sum{ 0 };
+
+	static jsc::value create_callback(double &sum, std::true_type)
+	{
+		return jsc::value::function<1>([&sum](const jsc::value &x) noexcept
+		{
+			sum += 1;
+			return x;
+		});
+	}
+
+	static jsc::value create_callback(double &sum, std::false_type)
+	{
+		return jsc::value::function<1>([&sum](double x)
+		{
+			sum += x;
+			return x;
+		});
+	}
+
+public:
+	native_calls()
+	{
+		auto create = jsc::RunScript(LR"==((function (callback) {
+	return function () {
+		var r = 0;
+		for (var i = 0; i < 1000; ++i)
+			r = callback(i);
+		return r;
+	};
+}))==", JS_SOURCE_CONTEXT_NONE, L"");
+
+		loop = create(nullptr, create_callback(sum, std::integral_constant<bool, NoExcept>{}));
+	}
+
+	void run() override
+	{
+		loop(nullptr);
+	}
+};
+
+// UTF-8 conversion through the library's transcoders
+class transcoder_strings
+{
+public:
+	std::wstring from_utf8(const std::string &text)
+	{
+		return jsc::details::utf::to_wstring(text.data(), text.size());
+	}
+
+	std::string to_utf8(const std::wstring &text)
+	{
+		return jsc::details::utf::to_utf8(text.data(), text.size());
+	}
+};
+
+// UTF-8 conversion through std::codecvt, as marshalling code commonly does it
+class codecvt_strings
+{
+#if defined(CBRIDGE_WCHAR_UTF16)
+	std::wstring_convert<std::codecvt_utf8_utf16<wchar_t>> convert;
+#else
+	std::wstring_convert<std::codecvt_utf8<wchar_t>> convert;
+#endif
+
+public:
+	std::wstring from_utf8(const std::string &text)
+	{
+		return convert.from_bytes(text);
+	}
+
+	std::string to_utf8(const std::wstring &text)
+	{
+		return convert.to_bytes(text);
+	}
+};
+
+// Append code point c to a UTF-8 string
+void append_utf8(std::string &text, char32_t c)
+{
+	char buffer[4];
+	text.append(buffer, jsc::details::utf::encode_utf8(c, buffer));
+}
+
+// Pass UTF-8 documents from the host to a script and the script's results back. Mostly ASCII with Cyrillic, CJK and
+// supplementary plane characters mixed in, so every transcoder path is exercised
+template<class Strings>
+class string_marshalling : public workload
+{
+	Strings strings;
+	jsc::referenced_value process;
+	std::vector<std::string> documents;
+
+public:
+	string_marshalling()
+	{
+		process = jsc::RunScript(LR"==((function (text) {
+	return text.length + ":" + text.substring(text.length >> 1);
+}))==", JS_SOURCE_CONTEXT_NONE, L"");
+
+		static const char32_t alphabet[] = { U'a', U'b', U'c', U' ', U'0', U'\u0436', U'\u044f', U'\u4e2d', U'\u6587', U'\U0001F600' };
+		std::mt19937 random{ 1 };
+		for (int i = 0; i < 32; ++i)
+		{
+			std::string document;
+			for (int j = 0; j < 256; ++j)
+				append_utf8(document, random() % 8 ? alphabet[random() % 5] : alphabet[5 + random() % 5]);
+			documents.push_back(std::move(document));
+		}
+	}
+
+	void run() override
+	{
+		size_t total = 0;
+		for (const auto &document : documents)
+			total += strings.to_utf8(process(nullptr, strings.from_utf8(document)).as_string()).size();
+		if (total == 0)
+			throw std::runtime_error("empty result");
+	}
+};
+
+struct workload_info
+{
+	const wchar_t *name;
+	std::unique_ptr<workload>(*create)();
+};
+
+template<class T>
+std::unique_ptr<workload> create_workload()
+{
+	return std::make_unique<T>();
+}
+
+const workload_info workloads[] =
+{
+	{ L"json_transform", &create_workload<json_transform> },
+	{ L"template_render", &create_workload<template_render> },
+	{ L"rules_engine", &create_workload<rules_engine> },
+	{ L"typed_array_kernel", &create_workload<typed_array_kernel> },
+	{ L"native_calls", &create_workload<native_calls<false>> },
+	{ L"native_calls_noexcept", &create_workload<native_calls<true>> },
+	{ L"strings_transcoder", &create_workload<string_marshalling<transcoder_strings>> },
+	{ L"strings_codecvt", &create_workload<string_marshalling<codecvt_strings>> },
+};
+
+struct options
+{
+	std::vector<const workload_info *> workloads;
+	std::vector<double> rates{ 100, 1000 };
+	unsigned int max_threads{ std::max(1u, std::thread::hardware_concurrency()) };
+	double duration{ 5 };
+	unsigned int warmup{ 100 };
+	unsigned int profile_us{ 0 };	// sampling interval, 0 disables profiling
+};
+
+struct thread_result
+{
+	std::vector<int64_t> latencies;	// nanoseconds
+	uint64_t errors{ 0 };
+	uint64_t samples{ 0 };
+	uint64_t stale{ 0 };
+	clock_type::time_point finished;
+	std::string failure;
+};
+
+// Requests are scheduled at fixed intervals and latency is measured from the scheduled time, so a slow request
+// delays the following ones instead of hiding the queueing it causes
+void worker(const workload_info &info, const options &opts, double rate, std::atomic<unsigned int> &ready, const std::atomic<clock_type::rep> &start_time, thread_result &result)
+{
+	// the runtime and context outlive the handlers below, which may look at the exception's JavaScript object
+	jsc::runtime runtime;
+	jsc::context ctx;
+	auto error = runtime.create(JsRuntimeAttributeNone);
+	if (error == JsNoError)
+		error = ctx.create(runtime);
+	std::unique_ptr<jsc::scoped_context> sc;
+	if (error == JsNoError)
+	{
+		try
+		{
+			sc = std::make_unique<jsc::scoped_context>(ctx);
+		}
+		catch (const jsc::exception &e)
+		{
+			error = e.code();
+		}
+	}
+	if (error != JsNoError)
+	{
+		result.failure = "engine error " + std::to_string(error);
+		ready.fetch_add(1);
+		return;
+	}
+
+	try
+	{
+#if defined(CBRIDGE_PROFILER)
+		// started before the workload is created, so warmup runs in debug mode as well
+		jsc::profiler profiler{ runtime, std::chrono::microseconds{ opts.profile_us } };
+		if (opts.profile_us)
+			profiler.start();
+#endif
+
+		auto w = info.create();
+		for (unsigned int i = 0; i < opts.warmup; ++i)
+			w->run();
+
+		ready.fetch_add(1);
+		clock_type::rep start_rep;
+		while ((start_rep = start_time.load()) == 0)
+			std::this_thread::yield();
+
+		auto start = clock_type::time_point{ clock_type::duration{ start_rep } };
+		auto end = start + std::chrono::duration_cast<clock_type::duration>(std::chrono::duration<double>(opts.duration));
+		auto interval = std::chrono::duration_cast<clock_type::duration>(std::chrono::duration<double>(1.0 / rate));
+		result.latencies.reserve(static_cast<size_t>(opts.duration * rate) + 1);
+
+		for (auto next = start; next < end; next += interval)
+		{
+			// sleep granularity is too coarse for short intervals: sleep until close to the scheduled time, then spin
+			for (auto now = clock_type::now(); now < next; now = clock_type::now())
+			{
+				if (next - now > std::chrono::milliseconds{ 2 })
+					std::this_thread::sleep_for(std::chrono::milliseconds{ 1 });
+				else
+					std::this_thread::yield();
+			}
+
+			try
+			{
+				w->run();
+			}
+			catch (...)
+			{
+				++result.errors;
+			}
+			result.latencies.push_back(std::chrono::duration_cast<std::chrono::nanoseconds>(clock_type::now() - next).count());
+		}
+		result.finished = clock_type::now();
+#if defined(CBRIDGE_PROFILER)
+		profiler.stop();
+		result.samples = profiler.samples();
+		result.stale = profiler.stale();
+#endif
+	}
+	catch (const jsc::exception &e)
+	{
+		result.failure = "engine error " + std::to_string(e.code());
+		ready.fetch_add(1);
+	}
+	catch (const std::exception &e)
+	{
+		result.failure = e.what();
+		ready.fetch_add(1);
+	}
+}
+
+size_t working_set()
+{
+	PROCESS_MEMORY_COUNTERS counters{ sizeof(counters) };
+	if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+		return 0;
+	return counters.WorkingSetSize;
+}
+
+// The process peak never goes down, so it cannot be compared between runs. Instead the current working set is
+// sampled while a run is in progress and the highest sample is reported relative to the working set before the run
+class working_set_sampler
+{
+	size_t baseline{ working_set() };
+	size_t peak{ baseline };
+	std::atomic<bool> stopped{ false };
+	std::thread thread{ [this]
+	{
+		while (!stopped.load())
+		{
+			peak = std::max(peak, working_set());
+			std::this_thread::sleep_for(std::chrono::milliseconds{ 10 });
+		}
+	} };
+
+public:
+	~working_set_sampler()
+	{
+		stop();
+	}
+
+	// stop sampling and return the growth of the working set in bytes
+	size_t stop()
+	{
+		if (thread.joinable())
+		{
+			stopped.store(true);
+			thread.join();
+			peak = std::max(peak, working_set());
+		}
+		return peak > baseline ? peak - baseline : 0;
+	}
+};
+
+std::string narrow(const wchar_t *text)
+{
+	std::string result;
+	for (; *text; ++text)
+		result.push_back(static_cast<char>(*text));
+	return result;
+}
+
+bool run(const workload_info &info, const options &opts, unsigned int threads, double rate)
+{
+	std::vector<thread_result> results(threads);
+	std::vector<std::thread> pool;
+	std::atomic<unsigned int> ready{ 0 };
+	std::atomic<clock_type::rep> start_time{ 0 };
+	working_set_sampler memory;
+
+	for (unsigned int i = 0; i < threads; ++i)
+		pool.emplace_back(worker, std::cref(info), std::cref(opts), rate, std::ref(ready), std::cref(start_time), std::ref(results[i]));
+
+	while (ready.load() < threads)
+		std::this_thread::sleep_for(std::chrono::milliseconds{ 1 });
+	auto start = clock_type::now() + std::chrono::milliseconds{ 10 };
+	start_time.store(start.time_since_epoch().count());
+
+	for (auto &t : pool)
+		t.join();
+	auto ws_growth = memory.stop();
+
+	std::vector<int64_t> latencies;
+	uint64_t errors = 0;
+	uint64_t samples = 0;
+	uint64_t stale = 0;
+	auto finished = start;
+	for (const auto &r : results)
+	{
+		if (!r.failure.empty())
+		{
+			std::cerr << narrow(info.name) << ": " << r.failure << std::endl;
+			return false;
+		}
+		latencies.insert(latencies.end(), r.latencies.begin(), r.latencies.end());
+		errors += r.errors;
+		samples += r.samples;
+		stale += r.stale;
+		finished = std::max(finished, r.finished);
+	}
+	std::sort(latencies.begin(), latencies.end());
+
+	auto percentile = [&](double q)
+	{
+		if (latencies.empty())
+			return 0.0;
+		return latencies[std::min(latencies.size() - 1, static_cast<size_t>(q * latencies.size()))] / 1e3;
+	};
+	auto elapsed = std::chrono::duration<double>(finished - start).count();
+
+	char line[512];
+	snprintf(line, sizeof(line),
+		"{\"workload\":\"%s\",\"threads\":%u,\"rate\":%.1f,\"duration\":%.3f,\"requests\":%zu,\"errors\":%llu,"
+		"\"throughput\":%.1f,\"p50_us\":%.1f,\"p99_us\":%.1f,\"p999_us\":%.1f,\"max_us\":%.1f,\"ws_growth\":%zu,"
+		"\"profile_us\":%u,\"samples\":%llu,\"stale\":%llu}",
+		narrow(info.name).c_str(), threads, rate, elapsed, latencies.size(), static_cast<unsigned long long>(errors),
+		elapsed > 0 ? latencies.size() / elapsed : 0.0, percentile(0.5), percentile(0.99), percentile(0.999),
+		latencies.empty() ? 0.0 : latencies.back() / 1e3, ws_growth,
+		opts.profile_us, static_cast<unsigned long long>(samples), static_cast<unsigned long long>(stale));
+	std::cout << line << std::endl;
+	return true;
+}
+
+// Round trip every code point through all transcoders at different positions relative to the vector width, compare
+// random text with std::codecvt and check that ill-formed input is replaced
+bool transcode_self_test()
+{
+	namespace utf = jsc::details::utf;
+	auto fail = [](const char *what, unsigned long c)
+	{
+		std::cerr << "self-test failed: " << what << " at U+" << std::hex << c << std::dec << std::endl;
+		return false;
+	};
+
+	char utf8[256], utf8_back[256];
+	char16_t utf16[128], utf16_back[128];
+	char32_t utf32[128], utf32_back[128];
+	for (char32_t c = 0; c <= 0x10FFFF; ++c)
+	{
+		if (utf::is_high_surrogate(c) || utf::is_low_surrogate(c))
+			continue;
+
+		size_t length = 0;
+		for (size_t i = 0, prefix = c % 67; i < prefix; ++i)
+			utf32[length++] = i % 3 ? U'x' : U'\u00e9';
+		utf32[length++] = c;
+		utf32[length++] = U'y';
+
+		auto n8 = utf::utf32_to_utf8(utf32, length, utf8);
+		auto n16 = utf::utf8_to_utf16(utf8, n8, utf16);
+		if (utf::utf16_to_utf32(utf16, n16, utf32_back) != length || !std::equal(utf32, utf32 + length, utf32_back))
+			return fail("UTF-8 -> UTF-16 -> UTF-32", c);
+		if (utf::utf16_to_utf8(utf16, n16, utf8_back) != n8 || !std::equal(utf8, utf8 + n8, utf8_back))
+			return fail("UTF-16 -> UTF-8", c);
+		if (utf::utf8_to_utf32(utf8, n8, utf32_back) != length || !std::equal(utf32, utf32 + length, utf32_back))
+			return fail("UTF-8 -> UTF-32", c);
+		if (utf::utf32_to_utf16(utf32, length, utf16_back) != n16 || !std::equal(utf16, utf16 + n16, utf16_back))
+			return fail("UTF-32 -> UTF-16", c);
+	}
+
+	transcoder_strings transcoder;
+	codecvt_strings codecvt;
+	std::mt19937 random{ 1 };
+	for (int i = 0; i < 10000; ++i)
+	{
+		std::string text;
+		for (auto n = random() % 200; n; --n)
+		{
+			char32_t c;
+			switch (random() % 4)
+			{
+			case 0: c = random() % 0x80; break;
+			case 1: c = 0x80 + random() % 0x780; break;
+			case 2: c = 0x800 + random() % 0xF800; break;
+			default: c = 0x10000 + random() % 0x100000; break;
+			}
+			append_utf8(text, utf::is_high_surrogate(c) || utf::is_low_surrogate(c) ? U'?' : c);
+		}
+		auto wide = transcoder.from_utf8(text);
+		if (wide != codecvt.from_utf8(text))
+			return fail("from_utf8 differs from codecvt in sample", i);
+		if (transcoder.to_utf8(wide) != text)
+			return fail("to_utf8 round trip in sample", i);
+	}
+
+	static const char *const ill_formed[] = { "a\xFF" "b", "a\xC0\x80" "b", "a\xED\xA0\x80" "b", "a\xE2\x82" "b", "a\xF4\x90\x80\x80" "b" };
+	for (auto text : ill_formed)
+	{
+		auto wide = transcoder.from_utf8(text);
+		if (wide.size() < 3 || wide.front() != L'a' || wide.back() != L'b' || !std::all_of(wide.begin() + 1, wide.end() - 1, [](wchar_t c) { return c == 0xFFFD; }))
+			return fail("ill-formed input not replaced", 0xFFFD);
+	}
+	return true;
+}
+
+int usage()
+{
+	std::wcerr << L"Usage: benchmark [--workload <name>]... [--threads <max>] [--rate <requests per second>[,...]]\n"
+		L"                 [--duration <seconds>] [--warmup <requests>] [--profile <sampling interval in microseconds>]\n"
+		L"       benchmark --self-test\n"
+		L"Workloads:";
+	for (const auto &w : workloads)
+		std::wcerr << L' ' << w.name;
+	std::wcerr << std::endl;
+	return 2;
+}
+
+int wmain(int argc, wchar_t *argv[])
+{
+	if (argc == 2 && argv[1] == std::wstring{ L"--self-test" })
+		return transcode_self_test() ? 0 : 1;
+
+	options opts;
+	for (int i = 1; i < argc; ++i)
+	{
+		std::wstring arg = argv[i];
+		if (i + 1 == argc)
+			return usage();
+		const wchar_t *v = argv[++i];
+
+		if (arg == L"--workload")
+		{
+			auto it = std::find_if(std::begin(workloads), std::end(workloads), [&](const workload_info &w) { return w.name == std::wstring{ v }; });
+			if (it == std::end(workloads))
+				return usage();
+			opts.workloads.push_back(&*it);
+		}
+		else if (arg == L"--threads")
+			opts.max_threads = std::max(1, _wtoi(v));
+		else if (arg == L"--rate")
+		{
+			opts.rates.clear();
+			for (wchar_t *p = const_cast<wchar_t *>(v); *p; )
+			{
+				auto rate = wcstod(p, &p);
+				if (rate <= 0 || (*p && *p != L','))
+					return usage();
+				opts.rates.push_back(rate);
+				if (*p)
+					++p;
+			}
+		}
+		else if (arg == L"--duration")
+			opts.duration = _wtof(v);
+		else if (arg == L"--warmup")
+			opts.warmup = static_cast<unsigned int>(std::max(0, _wtoi(v)));
+		else if (arg == L"--profile")
+		{
+#if defined(CBRIDGE_PROFILER)
+			opts.profile_us = static_cast<unsigned int>(std::max(0, _wtoi(v)));
+#else
+			std::wcerr << L"--profile requires a build with CBRIDGE_PROFILER defined (msbuild /p:Profiler=true)" << std::endl;
+			return 2;
+#endif
+		}
+		else
+			return usage();
+	}
+	if (opts.workloads.empty())
+		for (const auto &w : workloads)
+			opts.workloads.push_back(&w);
+	if (opts.rates.empty() || opts.duration <= 0)
+		return usage();
+
+	// default timer resolution would make sleeping threads miss their schedule by up to 15ms
+	timeBeginPeriod(1);
+
+	// scaling curve: 1, 2, 4, ... threads up to and including the maximum
+	std::vector<unsigned int> thread_counts;
+	for (unsigned int t = 1; t < opts.max_threads; t *= 2)
+		thread_counts.push_back(t);
+	thread_counts.push_back(opts.max_threads);
+
+	for (auto w : opts.workloads)
+		for (auto rate : opts.rates)
+			for (auto threads : thread_counts)
+				if (!run(*w, opts, threads, rate))
+					return 1;
+	return 0;
+}
@@ -0,0 +1,36 @@
+//-------------------------------------------------------------------------------------------------------
+// Copyright (C) 2016 HHD Software Ltd.
+// Written by Alexander Bessonov
+//
+// Licensed under the MIT license. See LICENSE.txt file in the project root for full license information.
+//-------------------------------------------------------------------------------------------------------
+
+// Code size probe, compiled by code_size.ps1 and not linked into the benchmark. Binds 300 distinct callables, a
+// third of them noexcept, the way an embedder exposing a large host API does
+
+#include <utility>
+#include <vector>
+
+#include <chakra_bridge/chakra_bridge.h>
+
+template<int N>
+void bind(std::vector<jsc::value> &functions)
+{
+	functions.push_back(jsc::value::function<2>([](double a, double b) { return a * b + N; }));
+	functions.push_back(jsc::value::function<1>([](const std::wstring &s) { return s + std::to_wstring(N); }));
+	functions.push_back(jsc::value::function<1>([](const jsc::value &x) noexcept { return x; }));
+}
+
+template<int... N>
+void bind_all(std::vector<jsc::value> &functions, std::integer_sequence<int, N...>)
+{
+	int expand[] = { (bind<N>(functions), 0)... };
+	(expand);
+}
+
+std::vector<jsc::value> bind_host_api()
+{
+	std::vector<jsc::value> functions;
+	bind_all(functions, std::make_integer_sequence<int, 100>{});
+	return functions;
+}
@@ -0,0 +1,68 @@
+# Measures the code size of benchmark\code_size.cpp compiled with the library headers of the working tree and,
+# optionally, of an earlier revision, for example the parent of a change to the native function dispatcher:
+#
+#   powershell -File benchmark\code_size.ps1 -Baseline <git revision>
+#
+# Run from a Visual Studio developer command prompt, so that cl and dumpbin are on the path. Sizes are the sums of all
+# .text and .rdata sections of the object file, which is compiled with the options of the Release configuration
+
+param(
+	[string]$Baseline
+)
+
+$ErrorActionPreference = 'Stop'
+$root = Split-Path -Parent $PSScriptRoot
+$work = Join-Path ([IO.Path]::GetTempPath()) 'chakra_bridge_code_size'
+Remove-Item -Recurse -Force $work -ErrorAction SilentlyContinue
+New-Item -ItemType Directory $work | Out-Null
+
+function Measure-Sections([string]$object)
+{
+	$sizes = @{ text = 0; rdata = 0 }
+	$name = $null
+	foreach ($line in & dumpbin /nologo /headers $object)
+	{
+		if ($line -match '^\s*\.(text|rdata)(\$\S*)?\s+name$')
+		{
+			$name = $matches[1]
+		}
+		elseif ($line -match '^\s*\.\S+\s+name$')
+		{
+			$name = $null
+		}
+		elseif ($name -and $line -match '^\s*([0-9A-F]+) size of raw data$')
+		{
+			$sizes[$name] += [Convert]::ToInt64($matches[1], 16)
+			$name = $null
+		}
+	}
+	$sizes
+}
+
+function Measure-Tree([string]$label, [string]$include)
+{
+	foreach ($optimization in '/O2', '/O1')
+	{
+		$object = Join-Path $work "$label$($optimization.Substring(1)).obj"
+		& cl /nologo /c /EHsc /Gy /Oi $optimization /DNDEBUG /D_UNICODE /DUNICODE "/I$include" "/I$root" "/Fo$object" (Join-Path $PSScriptRoot 'code_size.cpp') | Out-Null
+		if ($LASTEXITCODE -ne 0)
+		{
+			throw "cl failed for $label"
+		}
+		$sizes = Measure-Sections $object
+		'{0,-10} {1,-4} .text {2,10:N0}  .rdata {3,10:N0}' -f $label, $optimization, $sizes.text, $sizes.rdata
+	}
+}
+
+if ($Baseline)
+{
+	$archive = Join-Path $work 'baseline.zip'
+	& git -C $root archive --format=zip -o $archive $Baseline include
+	if ($LASTEXITCODE -ne 0)
+	{
+		throw "cannot read revision $Baseline"
+	}
+	Expand-Archive $archive (Join-Path $work 'baseline')
+	Measure-Tree 'baseline' (Join-Path $work 'baseline\include')
+}
+Measure-Tree 'current' (Join-Path $root 'include')
@@ -16,13 +16,64 @@
 #include <utility>
 #include <stdexcept>
 #include <array>
-#include <locale>
-#include <codecvt>
 #include <cassert>
 #include <memory>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <climits>
+#include <vector>
+#include <unordered_map>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <atomic>
+#include <system_error>
+#include <cerrno>
+#include <chrono>
+#include <condition_variable>
+#include <unordered_set>
+
+// memory mapped files and console output
+#if defined(_WIN32)
+#include <io.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
 
 // ChakraCore
 #include <ChakraCore/inc/chakracommon.h>
+#if defined(CBRIDGE_PROFILER)
+#include <ChakraCore/inc/ChakraDebug.h>
+#endif
+
+// Bridge
+#include "chakra_transcode.h"
+#if defined(CBRIDGE_TRACE) || defined(CBRIDGE_COUNTERS)
+#include "chakra_trace.h"
+#endif
+
+// Engine call counters. CBRIDGE_OPERATION marks the scope of a bridge operation, CBRIDGE_CALLBACK the scope of a native callback
+#if defined(CBRIDGE_COUNTERS)
+#define CBRIDGE_OPERATION(name) ::jsc::details::counters::operation_scope cbridge_operation_{ name }
+#define CBRIDGE_CALLBACK() ::jsc::details::counters::callback_scope cbridge_callback_
+#else
+#define CBRIDGE_OPERATION(name)
+#define CBRIDGE_CALLBACK()
+#endif
+
+// Sampling profiler. CBRIDGE_PROFILE_CALLBACK marks the scope of a native callback, so samples can name it,
+// CBRIDGE_PROFILE_SCRIPT the scope of a call that runs script. Breaks are only requested within these scopes
+#if defined(CBRIDGE_PROFILER)
+#define CBRIDGE_PROFILE_CALLBACK(state) ::jsc::details::profiler_scope cbridge_profile_{ state->label }
+#define CBRIDGE_PROFILE_SCRIPT() ::jsc::details::profiler_busy cbridge_profile_busy_
+#else
+#define CBRIDGE_PROFILE_CALLBACK(state)
+#define CBRIDGE_PROFILE_SCRIPT()
+#endif
 
 #pragma push_macro("max")
 #pragma push_macro("new")
@@ -88,21 +139,57 @@ namespace jsc
 		}
 
 		class value;
+		class release_queue;
+
+		// Reference to a JavaScript exception object, shared by an exception and its copies. When the last copy is
+		// destroyed, the reference is released on the thread that took it, queued on other threads and dropped if the
+		// runtime has been disposed in the meantime
+		struct exception_object
+		{
+			JsValueRef ref;
+			std::shared_ptr<release_queue> queue;	// runtime of the object, empty if unknown
+			std::thread::id owner;
+
+			exception_object(JsValueRef ref, std::shared_ptr<release_queue> queue) noexcept :
+				ref{ ref },
+				queue{ std::move(queue) },
+				owner{ std::this_thread::get_id() }
+			{}
+
+			exception_object(const exception_object &) = delete;
+			exception_object &operator =(const exception_object &) = delete;
+
+			~exception_object();
+
+			// false once the runtime has been disposed
+			bool alive() const noexcept;
+		};
 
 		class exception
 		{
 			JsErrorCode error;
+			std::shared_ptr<const exception_object> error_object;	// JavaScript exception taken from the engine, if any
 
 		public:
 			exception(JsErrorCode error) noexcept :
 				error{ error }
 			{}
 
+			// keeps a reference to the JavaScript exception object. Copies share it, so exceptions may be copied, moved
+			// to other threads and outlive the runtime
+			exception(JsErrorCode error, JsValueRef error_object) noexcept;
+
 			JsErrorCode code() const noexcept
 			{
 				return error;
 			}
 
+			// JavaScript exception object that caused the error, or an empty value. Empty once the runtime is disposed
+			value js_exception() const noexcept;
+
+			// text description of the error. Requires a current context
+			std::wstring message() const;
+
 			value to_js_exception() const;
 			value to_js_exception(const position_conversion_functor_t &posmap) const;
 		};
@@ -127,9 +214,49 @@ namespace jsc
 		inline void check(JsErrorCode error)
 		{
 			if (failed(error))
-				throw exception(error);
+			{
+				// take the pending JavaScript exception, so it can be inspected or rethrown unchanged
+				JsValueRef error_object = JS_INVALID_REFERENCE;
+				if (error == JsErrorScriptException || error == JsErrorScriptCompile)
+					JsGetAndClearException(&error_object);
+				throw exception(error, error_object);
+			}
+		}
+
+		// convert a size to the narrower type taken by ChakraCore, throwing if it does not fit
+		template<class T = unsigned int>
+		inline T checked_size(size_t size)
+		{
+			if (size > std::numeric_limits<T>::max())
+				throw exception(JsErrorInvalidArgument);
+			return static_cast<T>(size);
+		}
+
+		// resolve property identifier from its name, returning an error code
+		inline JsErrorCode get_property_id(const wchar_t *name, JsPropertyIdRef *propid)
+		{
+#if defined(CBRIDGE_WCHAR_UTF16)
+			return JsGetPropertyIdFromName(name, propid);
+#else
+			auto utf8 = utf::to_utf8(name, wcslen(name));
+			return JsCreatePropertyId(utf8.data(), utf8.size(), propid);
+#endif
+		}
+
+		// resolve property identifier from its name
+		inline JsPropertyIdRef property_id(const wchar_t *name)
+		{
+			JsPropertyIdRef propid;
+			check(get_property_id(name, &propid));
+			return propid;
 		}
 
+		// release library data associated with the contexts of a runtime
+		inline void release_context_data(JsRuntimeHandle runtime) noexcept;
+
+		// set a JavaScript exception constructed for a registered C++ exception type, see error_registry
+		inline JsValueRef throw_registered_error(const std::exception &e, JsValueRef message) noexcept;
+
 		class runtime
 		{
 			JsRuntimeHandle handle{ JS_INVALID_RUNTIME_HANDLE };
@@ -156,6 +283,7 @@ namespace jsc
 			{
 				if (handle != JS_INVALID_RUNTIME_HANDLE)
 				{
+					release_context_data(handle);
 					JsSetCurrentContext(JS_INVALID_REFERENCE);
 					JsDisposeRuntime(handle);
 				}
@@ -188,22 +316,172 @@ namespace jsc
 			}
 		};
 
+		// Releases of referenced_value made on threads other than the one running the runtime. Such releases are
+		// pushed to a lock-free list and performed in batches when the owning thread next enters the bridge: when a
+		// scoped_context is created or a native function is called
+		class release_queue
+		{
+			struct node
+			{
+				JsRef ref;
+				node *next;
+			};
+
+			std::atomic<node *> head{ nullptr };
+			std::atomic<bool> pending_{ false };
+			std::atomic<bool> disposed_{ false };
+
+			// free queued nodes without releasing their handles
+			static void discard(node *item) noexcept
+			{
+				while (item)
+				{
+					auto next = item->next;
+					delete item;
+					item = next;
+				}
+			}
+
+		public:
+			~release_queue()
+			{
+				discard(head.exchange(nullptr, std::memory_order_acquire));
+			}
+
+			// true if releases have been queued since the last drain
+			bool pending() const noexcept
+			{
+				return pending_.load(std::memory_order_relaxed);
+			}
+
+			// true once the runtime has been disposed. Handles of a disposed runtime must not be released
+			bool disposed() const noexcept
+			{
+				return disposed_.load(std::memory_order_acquire);
+			}
+
+			void push(JsRef ref) noexcept
+			{
+				if (disposed())
+					return;	// the runtime has freed all its objects
+				auto item = new (std::nothrow) node{ ref, head.load(std::memory_order_relaxed) };
+				if (!item)
+					return;	// leak the handle rather than release it on a wrong thread
+				while (!head.compare_exchange_weak(item->next, item, std::memory_order_release, std::memory_order_relaxed))
+					;
+				pending_.store(true, std::memory_order_relaxed);
+			}
+
+			// perform queued releases. Must be called on the thread running the runtime
+			void drain() noexcept
+			{
+				// cleared first, so a push racing with the exchange leaves the flag set for the next drain
+				pending_.store(false, std::memory_order_relaxed);
+				auto item = head.exchange(nullptr, std::memory_order_acquire);
+				while (item)
+				{
+					JsRelease(item->ref, nullptr);
+					auto next = item->next;
+					delete item;
+					item = next;
+				}
+			}
+
+			// perform queued releases and drop any made later. Called on the runtime's thread before it is disposed
+			void dispose() noexcept
+			{
+				drain();
+				disposed_.store(true, std::memory_order_release);
+			}
+
+			// drop queued and later releases. Called when the runtime is being disposed and its objects are freed
+			void abandon() noexcept
+			{
+				disposed_.store(true, std::memory_order_release);
+				discard(head.exchange(nullptr, std::memory_order_acquire));
+			}
+		};
+
+		// return the release queue of the current context's runtime, or nullptr if there is no current context
+		inline release_queue *current_release_queue() noexcept;
+
+		// release queue of the runtime the calling thread runs inside a scoped_context, if any
+		inline release_queue *&thread_release_queue() noexcept
+		{
+			static thread_local release_queue *queue{ nullptr };
+			return queue;
+		}
+
+		// release queue of the runtime running on the calling thread: the scoped_context's one if set, otherwise
+		// looked up from the current context
+		inline release_queue *owning_release_queue() noexcept
+		{
+			auto queue = thread_release_queue();
+			return queue ? queue : current_release_queue();
+		}
+
+		// drain the release queue of the current runtime
+		inline void drain_releases() noexcept;
+
 		class scoped_context
 		{
+			release_queue *previous;
+
 		public:
-			scoped_context(JsContextRef context)
+			scoped_context(JsContextRef context) :
+				previous{ thread_release_queue() }
 			{
 				check(JsSetCurrentContext(context));
+				auto queue = current_release_queue();
+				thread_release_queue() = queue;
+				if (queue)
+					queue->drain();
 			}
 
 			~scoped_context()
 			{
+				thread_release_queue() = previous;
 				auto success = succeeded(JsSetCurrentContext(JS_INVALID_REFERENCE));
 				success;
 				assert(success && "Error exiting context");
 			}
 		};
 
+		// return the release queue of the current context's runtime, shared with the runtime, or nullptr if there is
+		// no current context
+		inline std::shared_ptr<release_queue> shared_release_queue() noexcept;
+
+		inline exception::exception(JsErrorCode error, JsValueRef error_object) noexcept :
+			error{ error }
+		{
+			if (error_object == JS_INVALID_REFERENCE || failed(JsAddRef(error_object, nullptr)))
+				return;
+			try
+			{
+				this->error_object = std::make_shared<const exception_object>(error_object, shared_release_queue());
+			}
+			catch (const std::bad_alloc &)
+			{
+				JsRelease(error_object, nullptr);
+			}
+		}
+
+		inline exception_object::~exception_object()
+		{
+			if (!queue || owner == std::this_thread::get_id())
+			{
+				if (alive())
+					JsRelease(ref, nullptr);
+			}
+			else
+				queue->push(ref);
+		}
+
+		inline bool exception_object::alive() const noexcept
+		{
+			return !queue || !queue->disposed();
+		}
+
 		// forward declare property access proxies
 		class prop_ref_propid;
 		class prop_ref_indexed;
@@ -211,6 +489,12 @@ namespace jsc
 		template<class Base>
 		class prop_ref;
 
+		// forward declare adapter for JavaScript iterables
+		class iteration;
+
+		// forward declare key of hidden properties
+		class slot;
+
 		// type dispatch helpers
 		template<class T>
 		struct is_string_v
@@ -250,6 +534,278 @@ namespace jsc
 			static const bool value =/*is_string<T>::value && */is_enum_v<T>::value || is_bool_v<T>::value || is_small_int_v<T>::value || is_big_number_v<T>::value;
 		};
 
+		// map C++ element type to the corresponding typed array type
+		template<class T>
+		struct typed_array_type;
+
+		template<> struct typed_array_type<int8_t> { static const JsTypedArrayType value = JsArrayTypeInt8; };
+		template<> struct typed_array_type<uint8_t> { static const JsTypedArrayType value = JsArrayTypeUint8; };
+		template<> struct typed_array_type<int16_t> { static const JsTypedArrayType value = JsArrayTypeInt16; };
+		template<> struct typed_array_type<uint16_t> { static const JsTypedArrayType value = JsArrayTypeUint16; };
+		template<> struct typed_array_type<int32_t> { static const JsTypedArrayType value = JsArrayTypeInt32; };
+		template<> struct typed_array_type<uint32_t> { static const JsTypedArrayType value = JsArrayTypeUint32; };
+		template<> struct typed_array_type<float> { static const JsTypedArrayType value = JsArrayTypeFloat32; };
+		template<> struct typed_array_type<double> { static const JsTypedArrayType value = JsArrayTypeFloat64; };
+
+		// true if T has a typed array element type
+		template<class T>
+		struct is_typed_array_element : std::integral_constant<bool,
+			std::is_same<T, int8_t>::value || std::is_same<T, uint8_t>::value ||
+			std::is_same<T, int16_t>::value || std::is_same<T, uint16_t>::value ||
+			std::is_same<T, int32_t>::value || std::is_same<T, uint32_t>::value ||
+			std::is_same<T, float>::value || std::is_same<T, double>::value>
+		{};
+
+		// non-owning view of a contiguous sequence of elements
+		template<class T>
+		class array_view
+		{
+			T *ptr{ nullptr };
+			size_t length{ 0 };
+
+		public:
+			array_view() = default;
+
+			array_view(T *ptr, size_t length) noexcept :
+				ptr{ ptr },
+				length{ length }
+			{}
+
+			template<class U, class = std::enable_if_t<std::is_convertible<U(*)[], T(*)[]>::value>>
+			array_view(const array_view<U> &o) noexcept :
+				ptr{ o.data() },
+				length{ o.size() }
+			{}
+
+			template<class Container, class = decltype(std::declval<Container &>().data())>
+			array_view(Container &container) noexcept :
+				ptr{ container.data() },
+				length{ container.size() }
+			{}
+
+			T *data() const noexcept
+			{
+				return ptr;
+			}
+
+			size_t size() const noexcept
+			{
+				return length;
+			}
+
+			bool empty() const noexcept
+			{
+				return length == 0;
+			}
+
+			T *begin() const noexcept
+			{
+				return ptr;
+			}
+
+			T *end() const noexcept
+			{
+				return ptr + length;
+			}
+
+			T &operator [](size_t index) const noexcept
+			{
+				return ptr[index];
+			}
+		};
+
+		// mapped_file options
+		enum class access_hint
+		{
+			normal,
+			sequential,
+			random,
+		};
+
+		// Copy-on-write view of a whole file. Scripts may write to any ArrayBuffer, so the view is always writable;
+		// writes go to private pages and are not stored to the file
+		class mapped_view
+		{
+			void *data_{ nullptr };
+			size_t size_{ 0 };
+
+		public:
+			mapped_view(const wchar_t *path, access_hint hint)
+			{
+#if defined(_WIN32)
+				DWORD flags = FILE_ATTRIBUTE_NORMAL;
+				if (hint == access_hint::sequential)
+					flags |= FILE_FLAG_SEQUENTIAL_SCAN;
+				else if (hint == access_hint::random)
+					flags |= FILE_FLAG_RANDOM_ACCESS;
+
+				auto file = CreateFileW(path, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, flags, nullptr);
+				if (file == INVALID_HANDLE_VALUE)
+					throw std::system_error(static_cast<int>(GetLastError()), std::system_category(), "CreateFile");
+				std::unique_ptr<void, decltype(&CloseHandle)> file_guard{ file, &CloseHandle };
+
+				LARGE_INTEGER size;
+				if (!GetFileSizeEx(file, &size))
+					throw std::system_error(static_cast<int>(GetLastError()), std::system_category(), "GetFileSizeEx");
+				if (!size.QuadPart)
+					return;
+				if (static_cast<uint64_t>(size.QuadPart) > std::numeric_limits<size_t>::max())
+					throw std::system_error(std::make_error_code(std::errc::file_too_large));
+
+				auto mapping = CreateFileMappingW(file, nullptr, PAGE_WRITECOPY, 0, 0, nullptr);
+				if (!mapping)
+					throw std::system_error(static_cast<int>(GetLastError()), std::system_category(), "CreateFileMapping");
+				std::unique_ptr<void, decltype(&CloseHandle)> mapping_guard{ mapping, &CloseHandle };
+
+				data_ = MapViewOfFile(mapping, FILE_MAP_COPY, 0, 0, 0);
+				if (!data_)
+					throw std::system_error(static_cast<int>(GetLastError()), std::system_category(), "MapViewOfFile");
+				size_ = static_cast<size_t>(size.QuadPart);
+#else
+				auto fd = open(utf::to_utf8(path, wcslen(path)).c_str(), O_RDONLY | O_CLOEXEC);
+				if (fd < 0)
+					throw std::system_error(errno, std::generic_category(), "open");
+				std::unique_ptr<int, void(*)(int *)> fd_guard{ &fd, [](int *fd) { close(*fd); } };
+
+				struct stat st;
+				if (fstat(fd, &st) < 0)
+					throw std::system_error(errno, std::generic_category(), "fstat");
+				if (!st.st_size)
+					return;
+				if (static_cast<uint64_t>(st.st_size) > std::numeric_limits<size_t>::max())
+					throw std::system_error(std::make_error_code(std::errc::file_too_large));
+
+				auto size = static_cast<size_t>(st.st_size);
+				auto data = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+				if (data == MAP_FAILED)
+					throw std::system_error(errno, std::generic_category(), "mmap");
+				if (hint != access_hint::normal)
+					madvise(data, size, hint == access_hint::sequential ? MADV_SEQUENTIAL : MADV_RANDOM);	// advisory, failure is harmless
+				data_ = data;
+				size_ = size;
+#endif
+			}
+
+			mapped_view(const mapped_view &) = delete;
+			mapped_view &operator =(const mapped_view &) = delete;
+
+			~mapped_view()
+			{
+				if (data_)
+				{
+#if defined(_WIN32)
+					UnmapViewOfFile(data_);
+#else
+					munmap(data_, size_);
+#endif
+				}
+			}
+
+			void *data() const noexcept
+			{
+				return data_;
+			}
+
+			size_t size() const noexcept
+			{
+				return size_;
+			}
+		};
+
+#if defined(CBRIDGE_PROFILER)
+		// names of native functions, interned so that samples may refer to them after the functions are collected
+		inline const std::wstring *profiler_label(const wchar_t *name)
+		{
+			static std::mutex lock;
+			static std::unordered_set<std::wstring> labels;
+			std::lock_guard<std::mutex> guard{ lock };
+			return &*labels.insert(name ? name : L"(native)").first;
+		}
+
+		// activity of a thread, written by the thread and read by the timer thread of a profiler. state holds the
+		// number of script calls and native callbacks in progress in the low 32 bits and the number of times the
+		// thread became idle in the high 32 bits
+		struct profiler_activity
+		{
+			std::atomic<uint64_t> state{ 0 };
+			std::atomic<const std::wstring *> callback{ nullptr };	// innermost native callback
+		};
+
+		inline profiler_activity &profiled_activity() noexcept
+		{
+			static thread_local profiler_activity activity;
+			return activity;
+		}
+
+		// marks the thread busy. Only the owning thread writes the state, so no read-modify-write is needed
+		class profiler_busy
+		{
+		protected:
+			profiler_activity &activity;
+
+		public:
+			profiler_busy() noexcept :
+				activity{ profiled_activity() }
+			{
+				activity.state.store(activity.state.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+			}
+
+			profiler_busy(const profiler_busy &) = delete;
+			profiler_busy &operator =(const profiler_busy &) = delete;
+
+			~profiler_busy()
+			{
+				auto state = activity.state.load(std::memory_order_relaxed) - 1;
+				if ((state & 0xffffffff) == 0)
+					state += uint64_t{ 1 } << 32;
+				activity.state.store(state, std::memory_order_relaxed);
+			}
+		};
+
+		class profiler_scope : profiler_busy
+		{
+			const std::wstring *previous;
+
+		public:
+			explicit profiler_scope(const std::wstring *label) noexcept :
+				previous{ activity.callback.exchange(label, std::memory_order_relaxed) }
+			{}
+
+			~profiler_scope()
+			{
+				activity.callback.store(previous, std::memory_order_relaxed);
+			}
+		};
+#endif
+
+		// type-erased state of a native function, deleted when the function object is collected
+		struct native_function_state
+		{
+			using invoke_t = JsValueRef(*)(native_function_state *state, JsValueRef *arguments, unsigned short argumentCount);
+			invoke_t invoke;
+			release_queue *queue{ nullptr };	// runtime the function was created in, drained on entry
+#if defined(CBRIDGE_PROFILER)
+			const std::wstring *label{ nullptr };
+#endif
+
+			native_function_state(invoke_t invoke) noexcept :
+				invoke{ invoke }
+			{}
+
+			virtual ~native_function_state() = default;
+		};
+
+		template<class Callable>
+		struct native_function : native_function_state
+		{
+			Callable callable;
+
+			native_function(invoke_t invoke, Callable &&callable) :
+				native_function_state{ invoke },
+				callable{ std::move(callable) }
+			{}
+		};
+
 		class referenced_value;
 
 		class value
@@ -270,39 +826,159 @@ namespace jsc
 				return apply_helper(f, params, std::make_index_sequence<N>{});
 			}
 
-			template<size_t N, class Callable>
+			template<size_t N, bool NoExcept, class Callable>
 			static value execute_functor_helper(const Callable &f, const std::array<value, N> &values, std::true_type)
 			{
-				// void
+				// void. Functions that cannot throw return an empty reference, which ChakraCore treats as undefined
 				apply(f, values);
-				return undefined();
+				return NoExcept ? value{} : undefined();
 			}
 
-			template<size_t N, class Callable>
+			template<size_t N, bool NoExcept, class Callable>
 			static value execute_functor_helper(const Callable &f, const std::array<value, N> &values, std::false_type)
 			{
 				return value{ apply(f, values) };
 			}
 
-			template<size_t N, class Callable>
+			template<size_t N, bool NoExcept, class Callable>
 			static value execute_functor(const Callable &f, const std::array<value, N> &values)
 			{
-				return execute_functor_helper(f, values, std::is_same<void, decltype(apply(f, values))>{});
+				return execute_functor_helper<N, NoExcept>(f, values, std::is_same<void, decltype(apply(f, values))>{});
+			}
+
+			// true if a callable taking values and returning void or value cannot throw
+			template<size_t>
+			using value_arg_t = const value &;
+
+			template<class Callable, size_t... I>
+			static constexpr bool is_nothrow_functor(std::index_sequence<I...>)
+			{
+				return noexcept(std::declval<const Callable &>()(std::declval<value_arg_t<I>>()...));
+			}
+
+			template<size_t N, class Callable>
+			static constexpr bool is_nothrow_functor()
+			{
+				using result_t = decltype(apply(std::declval<const Callable &>(), std::declval<const std::array<value, N> &>()));
+				return (std::is_void<result_t>::value || std::is_same<value, std::decay_t<result_t>>::value) &&
+					is_nothrow_functor<Callable>(std::make_index_sequence<N>{});
+			}
+
+			// per-signature part of a native function: adapts JavaScript arguments to the callable
+			template<size_t ArgCount, size_t FirstArg, bool NoExcept, class Callable>
+			static JsValueRef invoke_functor(native_function_state *state, JsValueRef *arguments, unsigned short argumentCount)
+			{
+				const auto &f = static_cast<native_function<Callable> *>(state)->callable;
+				auto runtime_args = argumentCount - FirstArg;
+				auto begin = reinterpret_cast<value *>(arguments + FirstArg);
+
+				if (runtime_args >= ArgCount)
+					return execute_functor<ArgCount, NoExcept>(f, *reinterpret_cast<std::array<value, ArgCount> *>(begin));
+				else
+				{
+					std::array<value, ArgCount> params;
+					std::copy(begin, begin + runtime_args, params.begin());
+					return execute_functor<ArgCount, NoExcept>(f, params);
+				}
+			}
+
+			// shared entry point of all native functions. Translates C++ exceptions into JavaScript exceptions
+			static JsValueRef CHAKRA_CALLBACK dispatch(JsValueRef callee, bool isConstructCall, JsValueRef *arguments, unsigned short argumentCount, void *callbackState)
+			{
+				CBRIDGE_CALLBACK();
+				using namespace std::string_literals;
+				callee;
+				isConstructCall;
+				auto *state = static_cast<native_function_state *>(callbackState);
+				if (state->queue && state->queue->pending())
+					state->queue->drain();
+				CBRIDGE_PROFILE_CALLBACK(state);
+				try
+				{
+					return state->invoke(state, arguments, argumentCount);
+				}
+				catch (const exception &e)
+				{
+					return e.to_js_exception();
+				}
+				catch (const callback_exception &e)
+				{
+					JsValueRef result;
+					check(JsCreateError(value{ e.message() }, &result));
+					JsSetException(result);
+					return result;
+				}
+				catch (const std::exception &e)
+				{
+					auto message = from_utf8(e.what(), strlen(e.what()));
+					auto result = throw_registered_error(e, message);
+					if (result == JS_INVALID_REFERENCE)
+					{
+						check(JsCreateError(message, &result));
+						JsSetException(result);
+					}
+					return result;
+				}
+				catch (...)
+				{
+					JsValueRef result;
+					check(JsCreateError(value{ L"Unknown error"s }, &result));
+					JsSetException(result);
+					return result;
+				}
+			}
+
+			// shared entry point of native functions that cannot throw
+			static JsValueRef CHAKRA_CALLBACK dispatch_noexcept(JsValueRef callee, bool isConstructCall, JsValueRef *arguments, unsigned short argumentCount, void *callbackState) noexcept
+			{
+				CBRIDGE_CALLBACK();
+				callee;
+				isConstructCall;
+				auto *state = static_cast<native_function_state *>(callbackState);
+				if (state->queue && state->queue->pending())
+					state->queue->drain();
+				CBRIDGE_PROFILE_CALLBACK(state);
+				return state->invoke(state, arguments, argumentCount);
+			}
+
+			static void CHAKRA_CALLBACK release_function_state(JsRef ref, void *callbackState)
+			{
+				ref;
+				delete static_cast<native_function_state *>(callbackState);
 			}
 
 			// helpers to construct value from different types
-			static JsValueRef from(const std::wstring &text)
+			static JsValueRef from(const wchar_t *text, size_t length)
 			{
 				JsValueRef result;
-				check(JsPointerToString(text.c_str(), text.size(), &result));
+#if defined(CBRIDGE_WCHAR_UTF16)
+				check(JsPointerToString(text, length, &result));
+#else
+				utf::utf16_string utf16{ text, length };
+				check(JsCreateStringUtf16(reinterpret_cast<const uint16_t *>(utf16.data()), utf16.size(), &result));
+#endif
 				return result;
 			}
 
+			static JsValueRef from(const std::wstring &text)
+			{
+				return from(text.c_str(), text.size());
+			}
+
 			static JsValueRef from(const wchar_t *text)
 			{
-				JsValueRef result;
-				check(JsPointerToString(text, wcslen(text), &result));
-				return result;
+				return from(text, wcslen(text));
+			}
+
+			static JsValueRef from_utf8(const char *text, size_t length)
+			{
+				utf::buffer<wchar_t> wide{ length };
+#if defined(CBRIDGE_WCHAR_UTF16)
+				wide.resize(utf::utf8_to_utf16(text, length, reinterpret_cast<char16_t *>(wide.data())));
+#else
+				wide.resize(utf::utf8_to_utf32(text, length, reinterpret_cast<char32_t *>(wide.data())));
+#endif
+				return from(wide.data(), wide.size());
 			}
 
 			static JsValueRef from(double v)
@@ -441,16 +1117,79 @@ namespace jsc
 				else
 					return static_cast<T>(val);
 			}
-		public:
-			// static members that construct different types of ChakraCore values
 
-			// construct JavaScript array object and fill it with passed arguments
-			static value array(std::initializer_list<value> arguments)
+			// per-signature part of a variadic native function: passes all arguments except 'this'
+			template<class Callable>
+			static JsValueRef invoke_variadic(native_function_state *state, JsValueRef *arguments, unsigned short argumentCount)
 			{
-				JsValueRef result_;
-				check(JsCreateArray(static_cast<unsigned int>(arguments.size()), &result_));
-				auto result = value{ result_ };
-				for (size_t i = 0; i < arguments.size(); ++i)
+				const auto &f = static_cast<native_function<Callable> *>(state)->callable;
+				array_view<const value> args{ reinterpret_cast<const value *>(arguments + 1), argumentCount ? argumentCount - 1u : 0u };
+				return invoke_variadic(f, args, std::is_void<decltype(f(args))>{});
+			}
+
+			template<class Callable>
+			static JsValueRef invoke_variadic(const Callable &f, array_view<const value> args, std::true_type)
+			{
+				f(args);
+				return JS_INVALID_REFERENCE;
+			}
+
+			template<class Callable>
+			static JsValueRef invoke_variadic(const Callable &f, array_view<const value> args, std::false_type)
+			{
+				return value{ f(args) };
+			}
+
+			// construct JavaScript function object calling invoke with a given callable. The name is only used by
+			// the profiler
+			template<class Callable>
+			static value create_function(native_function_state::invoke_t invoke, bool no_except, Callable function, const wchar_t *name = nullptr)
+			{
+				CBRIDGE_OPERATION("value::function");
+				auto state = std::make_unique<native_function<Callable>>(invoke, std::move(function));
+				state->queue = owning_release_queue();
+#if defined(CBRIDGE_PROFILER)
+				state->label = profiler_label(name);
+#else
+				name;
+#endif
+				JsValueRef result;
+				check(JsCreateFunction(no_except ? &dispatch_noexcept : &dispatch, state.get(), &result));
+				check(JsSetObjectBeforeCollectCallback(result, state.get(), &release_function_state));
+				state.release();	// will be deleted in release_function_state
+				return value{ result };
+			}
+
+			// construct JavaScript function object. When invoked, a passed function is called with parameters converted
+			// FirstArg is the index of the first JavaScript argument passed to the callable: 0 includes 'this', 1 skips it
+			template<size_t ArgCount, size_t FirstArg, class Callable>
+			static value create_function(Callable function, const wchar_t *name = nullptr)
+			{
+				const bool no_except = is_nothrow_functor<ArgCount, Callable>();
+				return create_function(&invoke_functor<ArgCount, FirstArg, no_except, Callable>, no_except, std::move(function), name);
+			}
+
+			// build a data property descriptor equivalent to a plain assignment
+			static value data_descriptor(const value &value_)
+			{
+				return object()
+					.field(L"value", value_)
+					.field(L"writable", true_())
+					.field(L"enumerable", true_())
+					.field(L"configurable", true_());
+			}
+
+		public:
+			// static members that construct different types of ChakraCore values
+
+			// construct JavaScript array object and fill it with passed arguments
+			static value array(std::initializer_list<value> arguments)
+			{
+				CBRIDGE_OPERATION("value::array");
+				JsValueRef result_;
+				check(JsCreateArray(checked_size(arguments.size()), &result_));
+				auto result = value{ result_ };
+				for (size_t i = 0; i < arguments.size(); ++i)
 					result.set_indexed((int)i, arguments.begin()[i]);
 
 				return result;
@@ -470,7 +1209,7 @@ namespace jsc
 			{
 				const auto size = boost::size(range);
 				JsValueRef result_;
-				check(JsCreateArray((unsigned)size, &result_));
+				check(JsCreateArray(checked_size(size), &result_));
 				auto result = value{ result_ };
 				int i = 0;
 				for (const auto &e : range)
@@ -478,9 +1217,15 @@ namespace jsc
 				return result;
 			}
 
+			// construct JavaScript iterator producing elements of a C++ range. The range is stored in the iterator and
+			// its elements are converted in batches of up to prefetch elements per call into native code
+			template<class Range>
+			static value iterable(Range range, size_t prefetch = 64);
+
 			// construct JavaScript array object of a given size
 			static value uninitialized_array(unsigned int size = 0)
 			{
+				CBRIDGE_OPERATION("value::array");
 				JsValueRef result;
 				check(JsCreateArray(size, &result));
 				return value{ result };
@@ -489,18 +1234,21 @@ namespace jsc
 			// construct JavaScript ArrayBuffer object referencing external memory (check object lifetime!)
 			static value array_buffer(void *pdata, size_t size)
 			{
+				CBRIDGE_OPERATION("value::array_buffer");
 				JsValueRef result;
-				check(JsCreateExternalArrayBuffer(pdata, (unsigned int)size, nullptr, nullptr, &result));
+				check(JsCreateExternalArrayBuffer(pdata, checked_size(size), nullptr, nullptr, &result));
 				return value{ result };
 			}
 
 			// construct JavaScript ArrayBuffer object referencing copy of external memory
 			static value array_buffer_copy(const void *pdata, size_t size)
 			{
+				CBRIDGE_OPERATION("value::array_buffer");
+				auto length = checked_size(size);
 				auto copy = std::make_unique<BYTE[]>(size);
 				memcpy(copy.get(), pdata, size);
 				JsValueRef result;
-				check(JsCreateExternalArrayBuffer(copy.get(), (unsigned int)size, [](void *data)
+				check(JsCreateExternalArrayBuffer(copy.get(), length, [](void *data)
 				{
 					std::unique_ptr<BYTE[]> d(static_cast<BYTE *>(data));
 				}, copy.get(), &result));
@@ -508,14 +1256,58 @@ namespace jsc
 				return value{ result };
 			}
 
+			// construct JavaScript ArrayBuffer object backed by a copy-on-write mapping of a file. The view is unmapped
+			// when the ArrayBuffer is collected
+			static value mapped_file(const wchar_t *path, access_hint hint = access_hint::normal)
+			{
+				CBRIDGE_OPERATION("value::mapped_file");
+				auto view = std::make_unique<mapped_view>(path, hint);
+				if (!view->size())
+					return array_buffer(nullptr, 0);
+
+				JsValueRef result;
+				check(JsCreateExternalArrayBuffer(view->data(), checked_size(view->size()), [](void *state)
+				{
+					delete static_cast<mapped_view *>(state);
+				}, view.get(), &result));
+				view.release();	// will be deleted later in callback
+				return value{ result };
+			}
+
 			// construct JavaScript TypedArray object
 			static value typed_array(JsTypedArrayType arrayType, const value &baseArray, unsigned int byteOffset = 0, unsigned int elementLength = 0)
 			{
+				CBRIDGE_OPERATION("value::typed_array");
 				JsValueRef result;
 				check(JsCreateTypedArray(arrayType, baseArray, byteOffset, elementLength, &result));
 				return value{ result };
 			}
 
+			// construct JavaScript TypedArray object with its own storage
+			static value typed_array(JsTypedArrayType arrayType, unsigned int elementLength)
+			{
+				return typed_array(arrayType, value{}, 0, elementLength);
+			}
+
+			// construct JavaScript function object taking a single array argument and returning a typed array of the same length.
+			// If the argument is not a typed array of element type T, it is converted to one first. The kernel is called once
+			// with the input elements and the storage of the output typed array it must fill
+			template<class T, class U, class Kernel>
+			static value batch_function(Kernel kernel)
+			{
+				return function<1>([kernel = std::move(kernel)](value input)
+				{
+					JsTypedArrayType type;
+					if (failed(JsGetTypedArrayInfo(input, &type, nullptr, nullptr, nullptr)) || type != typed_array_type<T>::value)
+						input = typed_array(typed_array_type<T>::value, input);
+
+					auto source = input.typed_array_view<const T>();
+					value result = typed_array(typed_array_type<U>::value, checked_size(source.size()));
+					kernel(source, result.typed_array_view<U>());
+					return result;
+				});
+			}
+
 			// return null JavaScript value
 			static value null()
 			{
@@ -550,63 +1342,26 @@ namespace jsc
 			template<size_t ArgCount, class Callable>
 			static value function(Callable function)
 			{
-				using namespace std::string_literals;
-				auto pfcopy = std::make_unique<Callable>(std::move(function));
-				JsValueRef result;
-				check(JsCreateFunction([](JsValueRef callee, bool isConstructCall, JsValueRef *arguments, unsigned short argumentCount, void *pfcopy)->JsValueRef
-				{
-					callee;
-					isConstructCall;
-					auto runtime_args = argumentCount - 1;
-					auto begin = arguments + 1;
+				return create_function<ArgCount, 1>(std::move(function));
+			}
 
-					auto *pf = static_cast<Callable *>(pfcopy);
-					try
-					{
-						if (runtime_args >= ArgCount)
-							return execute_functor<ArgCount>(*pf, *reinterpret_cast<std::array<value, ArgCount> *>(begin));
-						else
-						{
-							std::array<value, ArgCount> params;
-							auto cbegin = reinterpret_cast<value *>(begin);
-							std::copy(cbegin, cbegin + runtime_args, params.begin());
-							return execute_functor<ArgCount>(*pf, params);
-						}
-					}
-					catch (const exception &e)
-					{
-						return e.to_js_exception();
-					}
-					catch (const callback_exception &e)
-					{
-						JsValueRef result;
-						check(JsCreateError(value{ e.message() }, &result));
-						JsSetException(result);
-						return result;
-					}
-					catch (const std::exception &e)
-					{
-						JsValueRef result;
-						check(JsCreateError(value{ std::wstring_convert<std::codecvt_utf8<wchar_t>>{}.from_bytes(e.what()) }, &result));
-						JsSetException(result);
-						return result;
-					}
-					catch (...)
-					{
-						JsValueRef result;
-						check(JsCreateError(value{ L"Unknown error"s }, &result));
-						JsSetException(result);
-						return result;
-					}
-				}, pfcopy.get(), &result));
+			// construct JavaScript function object. The callable receives 'this' value as its first argument,
+			// ArgCount does not include it
+			template<size_t ArgCount, class Callable>
+			static value function_with_this(Callable function)
+			{
+				return create_function<ArgCount + 1, 0>(std::move(function));
+			}
 
-				check(JsSetObjectBeforeCollectCallback(result, pfcopy.get(), [](JsRef ref, void *callbackState)
-				{
-					ref;
-					delete static_cast<Callable *>(callbackState);
-				}));
-				pfcopy.release();	// will be deleted in callback above
-				return value{ result };
+			// construct JavaScript function object taking any number of arguments. The callable receives
+			// array_view<const value> with all arguments except 'this'
+			template<class Callable>
+			static value variadic_function(Callable function)
+			{
+				using result_t = decltype(function(std::declval<array_view<const value>>()));
+				const bool no_except = noexcept(function(std::declval<array_view<const value>>())) &&
+					(std::is_void<result_t>::value || std::is_same<value, std::decay_t<result_t>>::value);
+				return create_function(&invoke_variadic<Callable>, no_except, std::move(function));
 			}
 
 			// return and clear the current runtime exception
@@ -620,6 +1375,7 @@ namespace jsc
 			// return a global object
 			static value global()
 			{
+				CBRIDGE_OPERATION("value::global");
 				JsValueRef global;
 				check(JsGetGlobalObject(&global));
 				return value{ global };
@@ -628,6 +1384,7 @@ namespace jsc
 			// construct new JavaScript object
 			static value object()
 			{
+				CBRIDGE_OPERATION("value::object");
 				JsValueRef result;
 				check(JsCreateObject(&result));
 				return value{ result };
@@ -636,6 +1393,7 @@ namespace jsc
 			// construct new JavaScript object based on COM object
 			static value object(IUnknown *pObj)
 			{
+				CBRIDGE_OPERATION("value::object");
 				JsValueRef result;
 				check(JsCreateExternalObject(pObj, [](void *p)
 				{
@@ -708,6 +1466,7 @@ namespace jsc
 			// value type retrieval
 			JsValueType value_type() const
 			{
+				CBRIDGE_OPERATION("value::value_type");
 				JsValueType result;
 				check(JsGetValueType(val, &result));
 				return result;
@@ -716,6 +1475,7 @@ namespace jsc
 			// conversion functions
 			value to_object() const
 			{
+				CBRIDGE_OPERATION("value::to_object");
 				JsValueRef result;
 				check(JsConvertValueToObject(val, &result));
 				return value{ result };
@@ -723,6 +1483,7 @@ namespace jsc
 
 			value to_number() const
 			{
+				CBRIDGE_OPERATION("value::to_number");
 				JsValueRef result;
 				check(JsConvertValueToNumber(val, &result));
 				return value{ result };
@@ -730,6 +1491,7 @@ namespace jsc
 
 			std::wstring to_string() const
 			{
+				CBRIDGE_OPERATION("value::to_string");
 				JsValueRef result;
 				check(JsConvertValueToString(val, &result));
 				return static_cast<std::wstring>(value{ result });
@@ -738,6 +1500,7 @@ namespace jsc
 			// prototype
 			value prototype() const
 			{
+				CBRIDGE_OPERATION("value::prototype");
 				JsValueRef result;
 				check(JsGetPrototype(val, &result));
 				return value{ result };
@@ -750,11 +1513,13 @@ namespace jsc
 
 			void set_indexed(value ordinal, const value &value) const
 			{
+				CBRIDGE_OPERATION("value::set_indexed");
 				check(JsSetIndexedProperty(this->val, ordinal, value));
 			}
 
 			value get_indexed(value ordinal) const
 			{
+				CBRIDGE_OPERATION("value::get_indexed");
 				JsValueRef result;
 				check(JsGetIndexedProperty(this->val, ordinal, &result));
 				return value{ result };
@@ -763,18 +1528,19 @@ namespace jsc
 			// properties
 			void set(const wchar_t *propname, const value &value) const
 			{
-				JsPropertyIdRef propid;
-				check(JsGetPropertyIdFromName(propname, &propid));
-				set(propid, value);
+				CBRIDGE_OPERATION("value::set");
+				set(property_id(propname), value);
 			}
 
 			void set(JsPropertyIdRef propid, const value &value) const
 			{
+				CBRIDGE_OPERATION("value::set");
 				check(JsSetProperty(this->val, propid, value, true));
 			}
 
 			bool define_property(JsPropertyIdRef id, const value &descriptor) const
 			{
+				CBRIDGE_OPERATION("value::define_property");
 				bool result;
 				check(JsDefineProperty(val, id, descriptor, &result));
 				return result;
@@ -782,26 +1548,47 @@ namespace jsc
 
 			bool define_property(const wchar_t *propname, const value &descriptor) const
 			{
-				JsPropertyIdRef propid;
-				check(JsGetPropertyIdFromName(propname, &propid));
-				return define_property(propid, descriptor);
+				CBRIDGE_OPERATION("value::define_property");
+				return define_property(property_id(propname), descriptor);
 			}
 
 			template<size_t ArgCount, class Callable>
 			value method(const wchar_t *name, Callable &&handler) const
 			{
-				(*this)[name] = function<ArgCount>(std::forward<Callable>(handler));
+				CBRIDGE_OPERATION("value::method");
+				(*this)[name] = create_function<ArgCount, 1>(std::forward<Callable>(handler), name);
 				return *this;	// copies are cheap
 			}
 
 			value field(const wchar_t *name, value value_) const;
 
+			// input range over a JavaScript iterable
+			iteration iterate() const;
+
+			// call this function once for each row of a contiguous container of std::tuple, in a single call into the
+			// engine. Returns an array of results, or std::vector<R> if R is arithmetic
+			template<class R = value, class Rows>
+			auto map_call(const Rows &rows) const;
+
+			// hidden properties keyed by per-context symbols, see slot class
+			void set_slot(const slot &id, const value &value_) const;
+
+			// store a native pointer in a slot. The pointer is not owned and must outlive its use by the script. A pointer
+			// slot is read-only and can be set once per object
+			template<class T, class = std::enable_if_t<std::is_class<T>::value>>
+			void set_slot(const slot &id, T *pointer) const;
+
+			// read a slot. Pointer slots return nullptr if the slot is not set or holds a pointer of another type
+			template<class T>
+			T get_slot(const slot &id) const;
+
 			template<class Getter>
 			value property(const wchar_t *name, Getter &&getter) const
 			{
+				CBRIDGE_OPERATION("value::property");
 				define_property(name, object()
 					.field(L"configurable", false_())
-					.field(L"get", function<0>(std::forward<Getter>(getter)))
+					.field(L"get", create_function<0, 1>(std::forward<Getter>(getter), name))
 					.field(L"set", function<1>([name = std::wstring{ name }](value)->value
 				{
 					using namespace std::string_literals;
@@ -817,10 +1604,34 @@ namespace jsc
 			template<class Getter, class Setter>
 			value property(const wchar_t *name, Getter &&getter, Setter &&setter) const
 			{
+				CBRIDGE_OPERATION("value::property");
 				define_property(name, object()
 					.field(L"configurable", false_())
-					.field(L"get", function<0>(std::forward<Getter>(getter)))
-					.field(L"set", function<1>(std::forward<Setter>(setter)))
+					.field(L"get", create_function<0, 1>(std::forward<Getter>(getter), name))
+					.field(L"set", create_function<1, 1>(std::forward<Setter>(setter), name))
+				);
+				return *this;
+			}
+
+			// Lazily initialized property. The factory is called on first access, after which the accessor
+			// replaces itself with a plain data property holding the returned value
+			template<class Factory>
+			value lazy_field(const wchar_t *name, Factory &&factory) const
+			{
+				CBRIDGE_OPERATION("value::lazy_field");
+				define_property(name, object()
+					.field(L"configurable", true_())
+					.field(L"enumerable", true_())
+					.field(L"get", function_with_this<0>([name = std::wstring{ name }, factory = std::forward<Factory>(factory)](value this_)
+				{
+					value result{ factory() };
+					this_.define_property(name.c_str(), data_descriptor(result));
+					return result;
+				}))
+					.field(L"set", function_with_this<1>([name = std::wstring{ name }](value this_, value value_)
+				{
+					this_.define_property(name.c_str(), data_descriptor(value_));
+				}))
 				);
 				return *this;
 			}
@@ -828,15 +1639,19 @@ namespace jsc
 			// function call
 			value operator()(std::initializer_list<value> arguments) const
 			{
+				CBRIDGE_OPERATION("value::operator()");
+				CBRIDGE_PROFILE_SCRIPT();
 				JsValueRef result;
-				check(JsCallFunction(val, reinterpret_cast<JsValueRef *>(const_cast<value *>((arguments.begin()))), (unsigned short)arguments.size(), &result));
+				check(JsCallFunction(val, reinterpret_cast<JsValueRef *>(const_cast<value *>((arguments.begin()))), checked_size<unsigned short>(arguments.size()), &result));
 				return value{ result };
 			}
 
 			value operator()(const value *begin, const value *end) const
 			{
+				CBRIDGE_OPERATION("value::operator()");
+				CBRIDGE_PROFILE_SCRIPT();
 				JsValueRef result;
-				check(JsCallFunction(val, reinterpret_cast<JsValueRef *>(const_cast<value *>(begin)), (unsigned short)std::distance(begin, end), &result));
+				check(JsCallFunction(val, reinterpret_cast<JsValueRef *>(const_cast<value *>(begin)), checked_size<unsigned short>(std::distance(begin, end)), &result));
 				return value{ result };
 			}
 
@@ -850,15 +1665,15 @@ namespace jsc
 			template<class...Args>
 			value call(JsPropertyIdRef methodid, Args &&...args) const
 			{
+				CBRIDGE_OPERATION("value::call");
 				return (*this)[methodid](*this, std::forward<Args>(args)...);
 			}
 
 			template<class...Args>
 			value call(const wchar_t *method_name, Args &&...args) const
 			{
-				JsPropertyIdRef propid;
-				check(JsGetPropertyIdFromName(method_name, &propid));
-				return call(propid, std::forward<Args>(args)...);
+				CBRIDGE_OPERATION("value::call");
+				return call(property_id(method_name), std::forward<Args>(args)...);
 			}
 
 			// value accessors
@@ -869,6 +1684,7 @@ namespace jsc
 
 			bool as_bool() const
 			{
+				CBRIDGE_OPERATION("value::as");
 				bool result;
 				check(JsBooleanToBool(val, &result));
 				return result;
@@ -876,6 +1692,7 @@ namespace jsc
 
 			int as_int() const
 			{
+				CBRIDGE_OPERATION("value::as");
 				int result;
 				check(JsNumberToInt(val, &result));
 				return result;
@@ -883,6 +1700,7 @@ namespace jsc
 
 			double as_double() const
 			{
+				CBRIDGE_OPERATION("value::as");
 				double result;
 				check(JsNumberToDouble(val, &result));
 				return result;
@@ -890,15 +1708,26 @@ namespace jsc
 
 			std::wstring as_string()const
 			{
+				CBRIDGE_OPERATION("value::as");
+#if defined(CBRIDGE_WCHAR_UTF16)
 				const wchar_t *ptr;
 				size_t length;
 				check(JsStringToPointer(val, &ptr, &length));
 				return{ ptr, length };
+#else
+				int length;
+				check(JsGetStringLength(val, &length));
+				utf::buffer<char16_t> utf16{ static_cast<size_t>(length) };
+				size_t written;
+				check(JsCopyStringUtf16(val, 0, length, reinterpret_cast<uint16_t *>(utf16.data()), &written));
+				return utf::to_wstring(utf16.data(), written);
+#endif
 			}
 
 			template<class T>
 			T as() const
 			{
+				CBRIDGE_OPERATION("value::as");
 				return as<T>(
 					std::integral_constant<bool, is_string_v<T>::value>{},
 					std::integral_constant<bool, is_bool_v<T>::value>{},
@@ -922,8 +1751,24 @@ namespace jsc
 			operator wchar_t()const = delete;
 			operator char()const = delete;
 
+			// return the storage of a typed array. Throws if the element type of the array is not T
+			template<class T>
+			array_view<T> typed_array_view() const
+			{
+				CBRIDGE_OPERATION("value::typed_array_view");
+				ChakraBytePtr buffer;
+				unsigned int length;
+				JsTypedArrayType type;
+				int element_size;
+				check(JsGetTypedArrayStorage(val, &buffer, &length, &type, &element_size));
+				if (type != typed_array_type<std::remove_const_t<T>>::value)
+					throw exception(JsErrorInvalidArgument);
+				return{ reinterpret_cast<T *>(buffer), length / sizeof(T) };
+			}
+
 			void *data() const
 			{
+				CBRIDGE_OPERATION("value::data");
 				void *res;
 				check(JsGetExternalData(val, &res));
 				return res;
@@ -998,18 +1843,53 @@ namespace jsc
 
 		class referenced_value : public value
 		{
+			friend class context_data;
+
+			release_queue *queue{ nullptr };	// runtime owning the reference
+			std::thread::id owner;	// thread that took the reference
+
 			void add_ref() noexcept
 			{
 				auto v = static_cast<JsValueRef>(*this);
 				if (v != JS_INVALID_REFERENCE)
+				{
+					JsAddRef(v, nullptr);
+					queue = owning_release_queue();
+					owner = std::this_thread::get_id();
+				}
+			}
+
+			// take an additional reference on a copy, keeping the owning runtime and thread. Only the owner thread may
+			// copy: other threads can only release references
+			void add_ref(release_queue *runtime_queue, std::thread::id owner_thread) noexcept
+			{
+				auto v = static_cast<JsValueRef>(*this);
+				if (v != JS_INVALID_REFERENCE)
+				{
+					assert(owner_thread == std::this_thread::get_id());
 					JsAddRef(v, nullptr);
+				}
+				queue = runtime_queue;
+				owner = owner_thread;
 			}
 
+			// references released on the thread that took them are released directly, others are queued
 			void release() noexcept
 			{
 				auto v = static_cast<JsValueRef>(*this);
 				if (v != JS_INVALID_REFERENCE)
-					JsRelease(v, nullptr);
+				{
+					if (owner == std::this_thread::get_id() || !queue)
+						JsRelease(v, nullptr);
+					else
+						queue->push(v);
+				}
+			}
+
+			// forget the reference without releasing it
+			void detach() noexcept
+			{
+				static_cast<value &>(*this) = value{};
 			}
 
 		public:
@@ -1036,16 +1916,20 @@ namespace jsc
 				add_ref();
 			}
 
-			referenced_value(referenced_value &&o) :
-				value{ static_cast<const value &>(o) }
+			referenced_value(referenced_value &&o) noexcept :
+				value{ static_cast<const value &>(o) },
+				queue{ o.queue },
+				owner{ o.owner }
 			{
-				static_cast<value &>(o) = value{ JS_INVALID_REFERENCE };
+				static_cast<value &>(o) = value{};
 			}
 
-			referenced_value &operator =(referenced_value &&o)
+			referenced_value &operator =(referenced_value &&o) noexcept
 			{
 				using std::swap;
 				swap(static_cast<value &>(*this), static_cast<value &>(o));
+				swap(queue, o.queue);
+				swap(owner, o.owner);
 				return *this;
 			}
 
@@ -1057,14 +1941,14 @@ namespace jsc
 			referenced_value(const referenced_value &o) noexcept :
 				value{ static_cast<const value &>(o) }
 			{
-				add_ref();
+				add_ref(o.queue, o.owner);
 			}
 
 			referenced_value &operator =(const referenced_value &o)
 			{
 				release();
 				static_cast<value &>(*this) = static_cast<const value &>(o);
-				add_ref();
+				add_ref(o.queue, o.owner);
 				return *this;
 			}
 		};
@@ -1129,6 +2013,7 @@ namespace jsc
 		public:
 			value get() const
 			{
+				CBRIDGE_OPERATION("prop_ref::get");
 				return Base::get(obj);
 			}
 
@@ -1162,6 +2047,7 @@ namespace jsc
 
 			prop_ref &operator =(value value)
 			{
+				CBRIDGE_OPERATION("prop_ref::set");
 				Base::set(obj, value);
 				return *this;
 			}
@@ -1204,9 +2090,8 @@ namespace jsc
 
 		inline prop_ref<prop_ref_propid> value::operator [](const wchar_t *propname) const
 		{
-			JsPropertyIdRef propid;
-			check(JsGetPropertyIdFromName(propname, &propid));
-			return operator[](propid);
+			CBRIDGE_OPERATION("value::operator[]");
+			return operator[](property_id(propname));
 		}
 
 		inline prop_ref<prop_ref_indexed> value::operator[](value index) const
@@ -1216,6 +2101,7 @@ namespace jsc
 
 		inline value value::field(const wchar_t *name, value value_) const
 		{
+			CBRIDGE_OPERATION("value::field");
 			(*this)[name] = value_;
 			return *this;
 		}
@@ -1226,178 +2112,3323 @@ namespace jsc
 		{
 		}
 
-		class exception_details : public value
+		// Per-context storage for values cached by the library, such as precompiled helper functions.
+		// Attached to the context with JsSetContextData and destroyed when the owning runtime is disposed
+		class context_data
 		{
+			friend class context_registry;
+
+			JsRuntimeHandle runtime{ JS_INVALID_RUNTIME_HANDLE };
+			std::shared_ptr<release_queue> queue_;
+			std::unordered_map<const void *, referenced_value> values;
+			std::map<std::wstring, JsPropertyIdRef, std::less<>> property_ids;
+			std::unordered_map<const void *, JsPropertyIdRef> symbol_ids;
+
 		public:
-			exception_details() :
-				value{ value::current_exception() }
+			context_data() = default;
+			context_data(const context_data &) = delete;
+			context_data &operator =(const context_data &) = delete;
+
+			~context_data()
 			{
+				for (const auto &item : property_ids)
+					JsRelease(item.second, nullptr);
+				for (const auto &item : symbol_ids)
+					JsRelease(item.second, nullptr);
 			}
 
-			std::wstring message() const
+			// forget all references without releasing them, as the engine is freeing the objects
+			void abandon() noexcept
 			{
-				try
-				{
-					return operator[](L"message").as_string();
-				}
-				catch (const exception &)
-				{
-					return{};
-				}
+				for (auto &item : values)
+					item.second.detach();
+				property_ids.clear();
+				symbol_ids.clear();
 			}
 
-			std::wstring stack() const
+			// return data of the current context, creating it on first use
+			static context_data &current();
+
+			// release queue of the context's runtime
+			release_queue *queue() const noexcept
 			{
-				try
-				{
-					return operator[](L"stack").as_string();
-				}
-				catch (const exception &)
-				{
-					return{};
-				}
+				return queue_.get();
 			}
 
-			std::wstring description() const
+			const std::shared_ptr<release_queue> &shared_queue() const noexcept
 			{
-				try
+				return queue_;
+			}
+
+			// return a value cached under a given key, calling factory to construct it on first use
+			template<class Factory>
+			value get(const void *key, Factory &&factory)
+			{
+				auto it = values.find(key);
+				if (it == values.end())
+					it = values.emplace(key, referenced_value{ value{ factory() } }).first;
+				return it->second;
+			}
+
+			// return an interned property identifier, resolving the name on first use
+			JsPropertyIdRef property_id(const wchar_t *name)
+			{
+				auto it = property_ids.find(name);
+				if (it == property_ids.end())
 				{
-					return operator [](L"description").as_string();
+					auto propid = details::property_id(name);
+					check(JsAddRef(propid, nullptr));
+					it = property_ids.emplace(name, propid).first;
 				}
-				catch (const exception &)
+				return it->second;
+			}
+
+			// return the property identifier of a symbol created for a given key on first use
+			JsPropertyIdRef symbol_id(const void *key, const wchar_t *description)
+			{
+				auto it = symbol_ids.find(key);
+				if (it == symbol_ids.end())
 				{
-					return{};
+					JsValueRef symbol;
+					check(JsCreateSymbol(value{ description }, &symbol));
+					JsPropertyIdRef propid;
+					check(JsGetPropertyIdFromSymbol(symbol, &propid));
+					check(JsAddRef(propid, nullptr));
+					it = symbol_ids.emplace(key, propid).first;
 				}
+				return it->second;
 			}
 		};
 
-		inline bool has_exception() noexcept
+		// Owns context_data objects, keyed by their context, and release queues of runtimes. Entries are released by
+		// jsc::runtime before the runtime is disposed. Entries of runtimes disposed directly are dropped when the engine
+		// collects their contexts, so a later runtime or context allocated at the same address never finds them
+		class context_registry
 		{
-			bool has;
-			return JsNoError == JsHasException(&has) && has;
-		}
+			std::mutex lock;
+			std::unordered_map<JsContextRef, std::unique_ptr<context_data>> items;
+			std::unordered_map<JsRuntimeHandle, std::shared_ptr<release_queue>> queues;
 
-		inline std::tuple<remapped_error, std::wstring> print_exception(JsErrorCode code, const position_conversion_functor_t &posmap)
-		{
-			using namespace std::string_literals;
-			auto remappedcode = map_error(code);
-			std::wstring message;
+			static void CHAKRA_CALLBACK context_collected(JsRef context, void *)
+			{
+				instance().abandon(context);
+			}
 
-			try
+			void abandon(JsContextRef context) noexcept
 			{
-				if (code == JsErrorCode::JsErrorScriptCompile || code == JsErrorCode::JsErrorScriptException)
+				std::unique_ptr<context_data> data;
+				std::shared_ptr<release_queue> queue;
 				{
-					exception_details einfo;
-					message = einfo.to_string();
-					if (code == JsErrorCode::JsErrorScriptCompile)
-					{
-						auto line = einfo[L"line"].as<int>();
-						auto column = einfo[L"column"].as<int>();
-
-						std::tie(line, column) = posmap(line, column);
-
-						message += L" ("s + std::to_wstring(line) + L":"s + std::to_wstring(column) + L")"s;
-					}
-					else
+					std::lock_guard<std::mutex> guard{ lock };
+					auto it = items.find(context);
+					if (it == items.end())
+						return;	// released by jsc::runtime
+					data = std::move(it->second);
+					items.erase(it);
+					// the runtime's last context: the runtime is being disposed
+					if (std::none_of(items.begin(), items.end(), [&](const auto &item) { return item.second->runtime == data->runtime; }))
 					{
-						try
-						{
-							message = einfo[L"stack"].as_string();
-						}
-						catch (const exception &)
+						auto q = queues.find(data->runtime);
+						if (q != queues.end())
 						{
+							queue = std::move(q->second);
+							queues.erase(q);
 						}
 					}
 				}
+				data->abandon();
+				data.reset();
+				if (queue)
+					queue->abandon();
 			}
-			catch (const exception &)
+
+		public:
+			static context_registry &instance()
 			{
+				static context_registry registry;
+				return registry;
 			}
 
-			return{ remappedcode,message };
-		}
+			context_data *add(JsRuntimeHandle runtime, JsContextRef context)
+			{
+				auto data = std::make_unique<context_data>();
+				data->runtime = runtime;
+				check(JsSetObjectBeforeCollectCallback(context, nullptr, &context_collected));
+				std::lock_guard<std::mutex> guard{ lock };
+				auto &queue = queues[runtime];
+				if (!queue)
+					queue = std::make_shared<release_queue>();
+				data->queue_ = queue;
+				auto &item = items[context];
+				item = std::move(data);
+				return item.get();
+			}
 
-		inline auto print_exception(JsErrorCode code)
-		{
-			return print_exception(code, identity());
-		}
+			void release(JsRuntimeHandle runtime) noexcept
+			{
+				std::vector<std::unique_ptr<context_data>> released;
+				std::shared_ptr<release_queue> queue;
+				{
+					std::lock_guard<std::mutex> guard{ lock };
+					for (auto it = items.begin(); it != items.end(); )
+					{
+						if (it->second->runtime == runtime)
+						{
+							released.push_back(std::move(it->second));
+							it = items.erase(it);
+						}
+						else
+							++it;
+					}
+					auto it = queues.find(runtime);
+					if (it != queues.end())
+					{
+						queue = std::move(it->second);
+						queues.erase(it);
+					}
+				}
+				// values cached by contexts may be queued. Exceptions may keep the queue after the runtime is disposed
+				released.clear();
+				if (queue)
+					queue->dispose();
+			}
+		};
 
-		inline auto print_exception(const exception &e, const position_conversion_functor_t &posmap)
+		inline context_data &context_data::current()
 		{
-			return print_exception(e.code(), posmap);
+			JsContextRef context;
+			check(JsGetCurrentContext(&context));
+			void *data;
+			check(JsGetContextData(context, &data));
+			if (!data)
+			{
+				JsRuntimeHandle runtime;
+				check(JsGetRuntime(context, &runtime));
+				data = context_registry::instance().add(runtime, context);
+				check(JsSetContextData(context, data));
+			}
+			return *static_cast<context_data *>(data);
 		}
 
-		inline auto print_exception(const exception &e)
+		inline void release_context_data(JsRuntimeHandle runtime) noexcept
 		{
-			return print_exception(e.code());
+			context_registry::instance().release(runtime);
 		}
 
-		inline value exception::to_js_exception() const
+		inline release_queue *current_release_queue() noexcept
 		{
-			return to_js_exception(identity());
+			try
+			{
+				JsContextRef context;
+				if (failed(JsGetCurrentContext(&context)) || context == JS_INVALID_REFERENCE)
+					return nullptr;
+				return context_data::current().queue();
+			}
+			catch (...)
+			{
+				return nullptr;
+			}
 		}
 
-		inline value exception::to_js_exception(const position_conversion_functor_t &posmap) const
+		inline std::shared_ptr<release_queue> shared_release_queue() noexcept
 		{
-			using namespace std::string_literals;
-			auto einfo = print_exception(code(), posmap);
 			try
 			{
-				JsValueRef exc;
-				static const wchar_t *error_messages[] = {
-					L"Invalid argument",
-					L"Null argument",
-					L"Argument not an object",
-					L"Out of memory",
-					L"Script error",
-					L"Syntax error",
-					L"Fatal error",
-					L"Exception",
-					L"Unexpected code"
-				};
-				check(JsCreateError(value{ error_messages[static_cast<int>(std::get<0>(einfo))] + L": "s + std::get<1>(einfo) }, &exc));
-				check(JsSetException(exc));
-				return value{ exc };
+				JsContextRef context;
+				if (failed(JsGetCurrentContext(&context)) || context == JS_INVALID_REFERENCE)
+					return nullptr;
+				return context_data::current().shared_queue();
 			}
-			catch (const exception &)
+			catch (...)
 			{
 				return nullptr;
 			}
 		}
 
-		// Run script helpers
-		inline value RunScript(const wchar_t *script, JsSourceContext sourceContext, const wchar_t *sourceUrl)
+		inline void drain_releases() noexcept
 		{
-			JsValueRef result;
-			check(JsRunScript(script, sourceContext, sourceUrl, &result));
-			return value{ result };
+			if (auto queue = owning_release_queue())
+				queue->drain();
 		}
 
-		inline value ParseScript(const wchar_t *script, JsSourceContext sourceContext, const wchar_t *sourceUrl)
+		// Key of hidden properties attached to any object with value::set_slot. Each slot is backed by a symbol created
+		// once per context, so slot properties are not enumerated and are accessed without name lookups. The address
+		// of a slot identifies it, so slots should be static objects
+		class slot
 		{
-			JsValueRef result;
-			check(JsParseScript(script, sourceContext, sourceUrl, &result));
-			return value{ result };
-		}
+			const wchar_t *description;
 
-		inline value ParseScriptWithAttributes(const wchar_t *script, JsSourceContext sourceContext, const wchar_t *sourceUrl, JsParseScriptAttributes parseAttributes)
-		{
-			JsValueRef result;
-			check(JsParseScriptWithAttributes(script, sourceContext, sourceUrl, parseAttributes, &result));
-			return value{ result };
-		}
+		public:
+			explicit slot(const wchar_t *description) noexcept :
+				description{ description }
+			{}
+
+			slot(const slot &) = delete;
+			slot &operator =(const slot &) = delete;
+
+			JsPropertyIdRef property_id() const
+			{
+				return context_data::current().symbol_id(this, description);
+			}
+		};
+
+		template<class T>
+		struct slot_traits
+		{
+			static T from(const value &value_)
+			{
+				return value_.as<T>();
+			}
+		};
+
+		template<>
+		struct slot_traits<value>
+		{
+			static value from(const value &value_)
+			{
+				return value_;
+			}
+		};
+
+		// Native pointer stored in a slot, tagged with its type. Scripts can copy slot properties between objects, so
+		// the external data of a slot property is only trusted if it is a live slot_pointer of the requested type
+		struct slot_pointer
+		{
+			const void *type;
+			void *pointer;
+
+			template<class T>
+			static const void *tag() noexcept
+			{
+				static const char type_tag = 0;
+				return &type_tag;
+			}
+
+			static std::mutex &lock() noexcept
+			{
+				static std::mutex lock_;
+				return lock_;
+			}
+
+			static std::unordered_set<const slot_pointer *> &live() noexcept
+			{
+				static std::unordered_set<const slot_pointer *> live_;
+				return live_;
+			}
+
+			static JsValueRef create(const void *type, void *pointer)
+			{
+				auto data = std::make_unique<slot_pointer>(slot_pointer{ type, pointer });
+				{
+					std::lock_guard<std::mutex> guard{ lock() };
+					live().insert(data.get());
+				}
+				JsValueRef holder;
+				auto error = JsCreateExternalObject(data.get(), &finalize, &holder);
+				if (failed(error))
+				{
+					finalize(data.release());
+					check(error);
+				}
+				data.release();	// deleted in finalize
+				return holder;
+			}
+
+			static void CHAKRA_CALLBACK finalize(void *data)
+			{
+				{
+					std::lock_guard<std::mutex> guard{ lock() };
+					live().erase(static_cast<const slot_pointer *>(data));
+				}
+				delete static_cast<slot_pointer *>(data);
+			}
+
+			// pointer stored in holder if it is a slot pointer of a given type, nullptr otherwise
+			static void *get(JsValueRef holder, const void *type) noexcept
+			{
+				void *data;
+				if (failed(JsGetExternalData(holder, &data)) || !data)
+					return nullptr;
+				std::lock_guard<std::mutex> guard{ lock() };
+				auto it = live().find(static_cast<const slot_pointer *>(data));
+				return it != live().end() && (*it)->type == type ? (*it)->pointer : nullptr;
+			}
+		};
+
+		template<class T>
+		struct slot_traits<T *>
+		{
+			static T *from(const value &value_)
+			{
+				if (!value_.is_object())
+					return nullptr;
+				return static_cast<T *>(slot_pointer::get(value_, slot_pointer::tag<std::remove_cv_t<T>>()));
+			}
+		};
+
+		inline void value::set_slot(const slot &id, const value &value_) const
+		{
+			CBRIDGE_OPERATION("value::set_slot");
+			check(JsSetProperty(val, id.property_id(), value_, true));
+		}
+
+		template<class T, class>
+		inline void value::set_slot(const slot &id, T *pointer) const
+		{
+			CBRIDGE_OPERATION("value::set_slot");
+			auto holder = slot_pointer::create(slot_pointer::tag<std::remove_cv_t<T>>(), const_cast<void *>(static_cast<const void *>(pointer)));
+			// read-only and non-configurable, so scripts cannot replace the pointer
+			if (!define_property(id.property_id(), object().field(L"value", value{ holder })))
+				throw exception(JsErrorInvalidArgument);
+		}
+
+		template<class T>
+		inline T value::get_slot(const slot &id) const
+		{
+			CBRIDGE_OPERATION("value::get_slot");
+			JsValueRef result;
+			check(JsGetProperty(val, id.property_id(), &result));
+			return slot_traits<T>::from(value{ result });
+		}
+
+		// Maps C++ exception types to JavaScript error constructors, such as RangeError, TypeError or classes defined
+		// by scripts in the global scope. When a native function throws a registered type, the library throws an error
+		// constructed with the exception's message instead of a plain Error. The most recently registered matching type
+		// wins, so register base classes first. Constructors are looked up once per context
+		class error_registry
+		{
+		public:
+			// sets additional properties of an error being thrown
+			class fields
+			{
+				value error;
+				context_data &data;
+
+			public:
+				fields(value error, context_data &data) noexcept :
+					error{ error },
+					data{ data }
+				{}
+
+				template<class T>
+				fields &set(const wchar_t *name, T &&value_)
+				{
+					error.set(data.property_id(name), value{ std::forward<T>(value_) });
+					return *this;
+				}
+			};
+
+		private:
+			struct entry
+			{
+				std::wstring constructor;
+				bool(*matches)(const std::exception &e);
+				std::function<void(const std::exception &e, fields &f)> fill;
+			};
+
+			std::mutex lock;
+			std::vector<std::unique_ptr<entry>> entries;	// entry addresses key the cached constructors
+
+			template<class E>
+			static bool matches(const std::exception &e)
+			{
+				return dynamic_cast<const E *>(&e) != nullptr;
+			}
+
+			// find a matching entry registered before a given position
+			const entry *find(const std::exception &e, size_t &position)
+			{
+				std::lock_guard<std::mutex> guard{ lock };
+				position = std::min(position, entries.size());
+				while (position)
+				{
+					auto item = entries[--position].get();
+					if (item->matches(e))
+						return item;
+				}
+				return nullptr;
+			}
+
+			static value constructor(context_data &data, const entry *item)
+			{
+				return data.get(item, [item]
+				{
+					value result = value::global()[item->constructor.c_str()];
+					if (!result.is_function())
+						throw exception(JsErrorInvalidArgument);
+					return result;
+				});
+			}
+
+		public:
+			static error_registry &instance()
+			{
+				static error_registry registry;
+				return registry;
+			}
+
+			// register a type with a function filling additional fields: void fill(const E &e, error_registry::fields &f)
+			template<class E, class Fill>
+			void add(const wchar_t *constructor, Fill fill)
+			{
+				static_assert(std::is_base_of<std::exception, E>::value, "Registered exception types must derive from std::exception");
+				auto item = std::make_unique<entry>();
+				item->constructor = constructor;
+				item->matches = &matches<E>;
+				item->fill = [fill = std::move(fill)](const std::exception &e, fields &f)
+				{
+					fill(static_cast<const E &>(e), f);
+				};
+				std::lock_guard<std::mutex> guard{ lock };
+				entries.push_back(std::move(item));
+			}
+
+			template<class E>
+			void add(const wchar_t *constructor)
+			{
+				add<E>(constructor, [](const E &, fields &) {});
+			}
+
+			// construct and set an error for e. Matching types whose constructor is not a global function are skipped.
+			// Returns JS_INVALID_REFERENCE if no registered type matches
+			JsValueRef raise(const std::exception &e, JsValueRef message) noexcept
+			{
+				try
+				{
+					auto position = std::numeric_limits<size_t>::max();
+					for (auto item = find(e, position); item; item = find(e, position))
+					{
+						auto &data = context_data::current();
+						value type;
+						try
+						{
+							type = constructor(data, item);
+						}
+						catch (const exception &)
+						{
+							continue;
+						}
+
+						JsValueRef arguments[] = { value::undefined(), message };
+						JsValueRef result;
+						check(JsConstructObject(type, arguments, 2, &result));
+						fields f{ value{ result }, data };
+						item->fill(e, f);
+						check(JsSetException(result));
+						return result;
+					}
+				}
+				catch (...)
+				{
+				}
+				return JS_INVALID_REFERENCE;
+			}
+		};
+
+		inline JsValueRef throw_registered_error(const std::exception &e, JsValueRef message) noexcept
+		{
+			return error_registry::instance().raise(e, message);
+		}
+
+		// translate exceptions of type E thrown by native functions into errors constructed by a global constructor
+		template<class E>
+		inline void register_error(const wchar_t *constructor)
+		{
+			error_registry::instance().add<E>(constructor);
+		}
+
+		// same, additionally setting error properties: void fill(const E &e, error_registry::fields &f)
+		template<class E, class Fill>
+		inline void register_error(const wchar_t *constructor, Fill fill)
+		{
+			error_registry::instance().add<E>(constructor, std::move(fill));
+		}
+
+		class exception_details : public value
+		{
+		public:
+			// takes the pending exception, which check() has already taken when an exception is caught
+			[[deprecated("the pending exception is taken by check(); use exception_details(const exception &)")]]
+			exception_details() :
+				value{ value::current_exception() }
+			{
+			}
+
+			explicit exception_details(const value &error_object) :
+				value{ error_object }
+			{
+			}
+
+			// details of the JavaScript exception stored in an exception, empty if it has none
+			explicit exception_details(const exception &e) :
+				value{ e.js_exception() }
+			{
+			}
+
+			std::wstring message() const
+			{
+				try
+				{
+					return operator[](L"message").as_string();
+				}
+				catch (const exception &)
+				{
+					return{};
+				}
+			}
+
+			std::wstring stack() const
+			{
+				try
+				{
+					return operator[](L"stack").as_string();
+				}
+				catch (const exception &)
+				{
+					return{};
+				}
+			}
+
+			std::wstring description() const
+			{
+				try
+				{
+					return operator [](L"description").as_string();
+				}
+				catch (const exception &)
+				{
+					return{};
+				}
+			}
+		};
+
+		inline bool has_exception() noexcept
+		{
+			bool has;
+			return JsNoError == JsHasException(&has) && has;
+		}
+
+		// describe an error. Without error_object, the pending exception of the current context is taken and cleared
+		inline std::tuple<remapped_error, std::wstring> print_exception(JsErrorCode code, JsValueRef error_object, const position_conversion_functor_t &posmap)
+		{
+			using namespace std::string_literals;
+			auto remappedcode = map_error(code);
+			std::wstring message;
+
+			try
+			{
+				if (code == JsErrorCode::JsErrorScriptCompile || code == JsErrorCode::JsErrorScriptException)
+				{
+					// check() and the library's wrappers take the pending exception; it is then kept in jsc::exception
+					if (error_object == JS_INVALID_REFERENCE && !has_exception())
+						return{ remappedcode, L"no exception information: the exception is no longer pending, describe the jsc::exception instead"s };
+
+					exception_details einfo{ error_object != JS_INVALID_REFERENCE ? value{ error_object } : value::current_exception() };
+					message = einfo.to_string();
+					if (code == JsErrorCode::JsErrorScriptCompile)
+					{
+						auto line = einfo[L"line"].as<int>();
+						auto column = einfo[L"column"].as<int>();
+
+						std::tie(line, column) = posmap(line, column);
+
+						message += L" ("s + std::to_wstring(line) + L":"s + std::to_wstring(column) + L")"s;
+					}
+					else
+					{
+						try
+						{
+							message = einfo[L"stack"].as_string();
+						}
+						catch (const exception &)
+						{
+						}
+					}
+				}
+			}
+			catch (const exception &)
+			{
+			}
+
+			return{ remappedcode,message };
+		}
+
+		// take and describe the pending exception. check() has already taken it when an exception is caught
+		[[deprecated("the pending exception is taken by check(); use print_exception(const exception &)")]]
+		inline auto print_exception(JsErrorCode code, const position_conversion_functor_t &posmap)
+		{
+			return print_exception(code, JS_INVALID_REFERENCE, posmap);
+		}
+
+		[[deprecated("the pending exception is taken by check(); use print_exception(const exception &)")]]
+		inline auto print_exception(JsErrorCode code)
+		{
+			return print_exception(code, JS_INVALID_REFERENCE, identity());
+		}
+
+		inline std::tuple<remapped_error, std::wstring> print_exception(const exception &e, const position_conversion_functor_t &posmap)
+		{
+			using namespace std::string_literals;
+			auto error_object = e.js_exception();
+			if (error_object.empty() && (e.code() == JsErrorCode::JsErrorScriptCompile || e.code() == JsErrorCode::JsErrorScriptException))
+				return{ map_error(e.code()), L"no exception information: the runtime has been disposed"s };
+			return print_exception(e.code(), error_object, posmap);
+		}
+
+		inline auto print_exception(const exception &e)
+		{
+			return print_exception(e, identity());
+		}
+
+		inline value exception::js_exception() const noexcept
+		{
+			if (!error_object || !error_object->alive())
+				return value{};
+			return value{ error_object->ref };
+		}
+
+		inline std::wstring exception::message() const
+		{
+			return std::get<1>(print_exception(*this));
+		}
+
+		inline value exception::to_js_exception() const
+		{
+			return to_js_exception(identity());
+		}
+
+		inline value exception::to_js_exception(const position_conversion_functor_t &posmap) const
+		{
+			using namespace std::string_literals;
+			// rethrow the original exception object
+			auto error_object = js_exception();
+			if (!error_object.empty())
+			{
+				JsSetException(error_object);
+				return error_object;
+			}
+
+			auto einfo = print_exception(*this, posmap);
+			try
+			{
+				JsValueRef exc;
+				static const wchar_t *error_messages[] = {
+					L"Invalid argument",
+					L"Null argument",
+					L"Argument not an object",
+					L"Out of memory",
+					L"Script error",
+					L"Syntax error",
+					L"Fatal error",
+					L"Exception",
+					L"Unexpected code"
+				};
+				check(JsCreateError(value{ error_messages[static_cast<int>(std::get<0>(einfo))] + L": "s + std::get<1>(einfo) }, &exc));
+				check(JsSetException(exc));
+				return value{ exc };
+			}
+			catch (const exception &)
+			{
+				return nullptr;
+			}
+		}
+
+		// Run script helpers
+		inline value RunScript(const wchar_t *script, JsSourceContext sourceContext, const wchar_t *sourceUrl)
+		{
+			CBRIDGE_PROFILE_SCRIPT();
+			JsValueRef result;
+			check(JsRunScript(script, sourceContext, sourceUrl, &result));
+			return value{ result };
+		}
+
+		inline value ParseScript(const wchar_t *script, JsSourceContext sourceContext, const wchar_t *sourceUrl)
+		{
+			JsValueRef result;
+			check(JsParseScript(script, sourceContext, sourceUrl, &result));
+			return value{ result };
+		}
+
+		inline value ParseScriptWithAttributes(const wchar_t *script, JsSourceContext sourceContext, const wchar_t *sourceUrl, JsParseScriptAttributes parseAttributes)
+		{
+			JsValueRef result;
+			check(JsParseScriptWithAttributes(script, sourceContext, sourceUrl, parseAttributes, &result));
+			return value{ result };
+		}
 
 		inline value ExperimentalApiRunModule(const wchar_t *script, JsSourceContext sourceContext, const wchar_t *sourceUrl)
 		{
-			JsValueRef result;
-			check(JsExperimentalApiRunModule(script, sourceContext, sourceUrl, &result));
-			return value{ result };
+			CBRIDGE_PROFILE_SCRIPT();
+			JsValueRef result;
+			check(JsExperimentalApiRunModule(script, sourceContext, sourceUrl, &result));
+			return value{ result };
+		}
+
+		inline value RunSerializedScript(const wchar_t *script, BYTE *buffer, JsSourceContext sourceContext, const wchar_t *sourceUrl)
+		{
+			CBRIDGE_PROFILE_SCRIPT();
+			JsValueRef result;
+			check(JsRunSerializedScript(script, buffer, sourceContext, sourceUrl, &result));
+			return value{ result };
+		}
+
+		// Parallel script precompilation
+		struct script_source
+		{
+			const wchar_t *script;
+			position_conversion_functor_t posmap{ identity() };	// maps compilation error positions
+		};
+
+		struct precompiled_script
+		{
+			std::vector<BYTE> buffer;	// serialized script, empty if compilation failed
+			JsErrorCode error{ JsNoError };
+			std::wstring message;		// compilation error description with mapped position
+
+			explicit operator bool() const noexcept
+			{
+				return error == JsNoError;
+			}
+		};
+
+		// serialize a single script in the current context
+		inline void serialize_script(const script_source &source, precompiled_script &result) noexcept
+		{
+			try
+			{
+				unsigned int size = 0;
+				result.error = JsSerializeScript(source.script, nullptr, &size);
+				if (succeeded(result.error))
+				{
+					result.buffer.resize(size);
+					result.error = JsSerializeScript(source.script, result.buffer.data(), &size);
+				}
+				if (failed(result.error))
+				{
+					result.buffer.clear();
+					result.message = std::get<1>(print_exception(result.error, JS_INVALID_REFERENCE, source.posmap));
+				}
+			}
+			catch (const std::bad_alloc &)
+			{
+				result.buffer.clear();
+				result.error = JsErrorOutOfMemory;
+			}
+		}
+
+		// Parse and serialize scripts in parallel, each worker thread using its own helper runtime which is disposed on
+		// return. The calling thread only waits, so its current context is left intact and precompile may be called from
+		// native callbacks. Load the results with RunSerializedScript, passing the original script text. Serialized buffers
+		// must outlive the runtime that runs them
+		inline std::vector<precompiled_script> precompile(array_view<const script_source> sources, unsigned int threads = std::thread::hardware_concurrency())
+		{
+			std::vector<precompiled_script> results(sources.size());
+			std::atomic<size_t> next{ 0 };
+
+			auto worker = [&]() noexcept
+			{
+				runtime rt;
+				context ctx;
+				auto error = rt.create(JsRuntimeAttributeDisableBackgroundWork);
+				if (succeeded(error))
+					error = ctx.create(rt);
+				if (succeeded(error))
+					error = JsSetCurrentContext(ctx);
+
+				for (size_t i; (i = next++) < sources.size();)
+				{
+					if (failed(error))
+						results[i].error = error;
+					else
+						serialize_script(sources[i], results[i]);
+				}
+			};
+
+			threads = static_cast<unsigned int>(std::min<size_t>(std::max(threads, 1u), sources.size()));
+			std::vector<std::thread> pool;
+			pool.reserve(threads);
+			try
+			{
+				for (unsigned int i = 0; i < threads; ++i)
+					pool.emplace_back(worker);
+			}
+			catch (...)
+			{
+				// workers already started process all sources
+				if (pool.empty())
+					throw;
+			}
+			for (auto &t : pool)
+				t.join();
+			return results;
+		}
+
+		// Records object graph construction into a compact command buffer which is then replayed by a
+		// precompiled script function in a single call. Handles refer to objects and arrays created by the builder
+		class batch_builder
+		{
+		public:
+			enum class handle : int32_t {};
+
+			// operand of set and push operations
+			class item
+			{
+				friend class batch_builder;
+
+				enum kind_t : int32_t
+				{
+					kind_handle,
+					kind_number,
+					kind_string,
+					kind_true,
+					kind_false,
+					kind_null,
+				} kind;
+				int32_t index{ 0 };
+				double number{ 0 };
+				const wchar_t *text{ nullptr };
+				size_t length{ 0 };
+
+			public:
+				item(handle h) noexcept :
+					kind{ kind_handle },
+					index{ static_cast<int32_t>(h) }
+				{}
+
+				item(bool v) noexcept :
+					kind{ v ? kind_true : kind_false }
+				{}
+
+				item(nullptr_t) noexcept :
+					kind{ kind_null }
+				{}
+
+				item(const wchar_t *text) noexcept :
+					kind{ kind_string },
+					text{ text },
+					length{ wcslen(text) }
+				{}
+
+				item(const std::wstring &text) noexcept :
+					kind{ kind_string },
+					text{ text.c_str() },
+					length{ text.size() }
+				{}
+
+				template<class T, class = std::enable_if_t<std::is_arithmetic<T>::value && !std::is_same<bool, T>::value>>
+				item(T v) noexcept :
+					kind{ kind_number },
+					number{ static_cast<double>(v) }
+				{}
+			};
+
+		private:
+			enum opcode : int32_t
+			{
+				op_object,		// op_object
+				op_array,		// op_array
+				op_set,			// op_set, target, key, kind, operand
+				op_push,		// op_push, target, kind, operand
+			};
+
+			std::vector<int32_t> ops;
+			std::vector<double> numbers;
+			std::wstring chars;
+			std::vector<int32_t> offsets{ 0 };
+			std::unordered_map<std::wstring, int32_t> strings;
+			int32_t count{ 0 };
+
+			int32_t intern(const wchar_t *text, size_t length)
+			{
+				auto result = strings.emplace(std::wstring{ text, length }, static_cast<int32_t>(offsets.size() - 1));
+				if (result.second)
+				{
+					chars.append(text, length);
+					offsets.push_back(static_cast<int32_t>(chars.size()));
+				}
+				return result.first->second;
+			}
+
+			void encode(const item &v)
+			{
+				ops.push_back(v.kind);
+				switch (v.kind)
+				{
+				case item::kind_handle:
+					ops.push_back(v.index);
+					break;
+				case item::kind_number:
+					ops.push_back(static_cast<int32_t>(numbers.size()));
+					numbers.push_back(v.number);
+					break;
+				case item::kind_string:
+					ops.push_back(intern(v.text, v.length));
+					break;
+				default:
+					ops.push_back(0);
+					break;
+				}
+			}
+
+			template<class T>
+			static value view(JsTypedArrayType type, const std::vector<T> &data)
+			{
+				// buffers only need to live for the duration of build call
+				if (data.empty())
+					return value::typed_array(type, 0);
+				return value::typed_array(type, value::array_buffer(const_cast<T *>(data.data()), data.size() * sizeof(T)), 0, checked_size(data.size()));
+			}
+
+			static value interpreter()
+			{
+				static const char key = 0;
+				return context_data::current().get(&key, []
+				{
+					return RunScript(LR"==((function (ops, numbers, chars, offsets, root) {
+	var refs = [], strings = [], i = 0, n = ops.length;
+	function str(k) {
+		var s = strings[k];
+		if (s === undefined)
+			s = strings[k] = chars.substring(offsets[k], offsets[k + 1]);
+		return s;
+	}
+	function operand(kind, index) {
+		switch (kind) {
+		case 0: return refs[index];
+		case 1: return numbers[index];
+		case 2: return str(index);
+		case 3: return true;
+		case 4: return false;
+		default: return null;
+		}
+	}
+	while (i < n) {
+		switch (ops[i]) {
+		case 0: refs[refs.length] = {}; i += 1; break;
+		case 1: refs[refs.length] = []; i += 1; break;
+		case 2: refs[ops[i + 1]][str(ops[i + 2])] = operand(ops[i + 3], ops[i + 4]); i += 5; break;
+		case 3: refs[ops[i + 1]].push(operand(ops[i + 2], ops[i + 3])); i += 4; break;
+		default: throw new Error("batch_builder: invalid opcode");
+		}
+	}
+	return refs[root];
+}))==", JS_SOURCE_CONTEXT_NONE, L"");
+				});
+			}
+
+		public:
+			// create new object
+			handle object()
+			{
+				ops.push_back(op_object);
+				return static_cast<handle>(count++);
+			}
+
+			// create new array
+			handle array()
+			{
+				ops.push_back(op_array);
+				return static_cast<handle>(count++);
+			}
+
+			// assign object property
+			batch_builder &set(handle target, const wchar_t *name, const item &v)
+			{
+				ops.push_back(op_set);
+				ops.push_back(static_cast<int32_t>(target));
+				ops.push_back(intern(name, wcslen(name)));
+				encode(v);
+				return *this;
+			}
+
+			// append array element
+			batch_builder &push(handle target, const item &v)
+			{
+				ops.push_back(op_push);
+				ops.push_back(static_cast<int32_t>(target));
+				encode(v);
+				return *this;
+			}
+
+			// construct recorded objects in the current context and return the one referenced by root
+			value build(handle root = handle{}) const
+			{
+				return interpreter()(nullptr, view(JsArrayTypeInt32, ops), view(JsArrayTypeFloat64, numbers), chars, view(JsArrayTypeInt32, offsets), static_cast<int32_t>(root));
+			}
+
+			void clear()
+			{
+				ops.clear();
+				numbers.clear();
+				chars.clear();
+				offsets.assign(1, 0);
+				strings.clear();
+				count = 0;
+			}
+		};
+
+		// Packs rows of value::map_call column-wise. Numbers are passed as typed arrays referencing the packed columns,
+		// strings as one concatenated string with offsets, other values as arrays. A per-context driver script calls
+		// the target for each row
+		class map_call_packer
+		{
+			enum kind_t : int32_t
+			{
+				kind_element,	// column[i]
+				kind_bool,		// column[i] !== 0
+				kind_string,	// column[0].substring(column[1][i], column[1][i + 1])
+			};
+
+			template<class T>
+			static value view(const T *data, size_t size)
+			{
+				// buffers only need to live for the duration of the call
+				if (!size)
+					return value::typed_array(typed_array_type<T>::value, 0);
+				return value::typed_array(typed_array_type<T>::value, value::array_buffer(const_cast<T *>(data), size * sizeof(T)), 0, checked_size(size));
+			}
+
+			// values of other types are converted one by one
+			template<class T, class = void>
+			struct column
+			{
+				static const int32_t kind = kind_element;
+				value values;
+
+				template<class Row, size_t I>
+				column(array_view<const Row> rows, std::integral_constant<size_t, I>) :
+					values{ value::uninitialized_array(checked_size(rows.size())) }
+				{
+					for (size_t i = 0; i < rows.size(); ++i)
+						values.set_indexed(static_cast<int>(i), value{ std::get<I>(rows[i]) });
+				}
+
+				value js() const
+				{
+					return values;
+				}
+			};
+
+			template<class T>
+			struct column<T, std::enable_if_t<std::is_arithmetic<T>::value && !std::is_same<T, bool>::value && !std::is_same<T, char>::value && !std::is_same<T, wchar_t>::value>>
+			{
+				static const int32_t kind = kind_element;
+				using element_t = std::conditional_t<is_typed_array_element<T>::value, T, double>;
+				std::vector<element_t> data;
+
+				template<class Row, size_t I>
+				column(array_view<const Row> rows, std::integral_constant<size_t, I>)
+				{
+					data.reserve(rows.size());
+					for (const auto &row : rows)
+						data.push_back(static_cast<element_t>(std::get<I>(row)));
+				}
+
+				value js() const
+				{
+					return view(data.data(), data.size());
+				}
+			};
+
+			template<class T>
+			struct column<T, std::enable_if_t<std::is_same<T, bool>::value>>
+			{
+				static const int32_t kind = kind_bool;
+				std::vector<uint8_t> data;
+
+				template<class Row, size_t I>
+				column(array_view<const Row> rows, std::integral_constant<size_t, I>)
+				{
+					data.reserve(rows.size());
+					for (const auto &row : rows)
+						data.push_back(std::get<I>(row) ? 1 : 0);
+				}
+
+				value js() const
+				{
+					return view(data.data(), data.size());
+				}
+			};
+
+			template<class T>
+			struct column<T, std::enable_if_t<std::is_same<T, std::wstring>::value || std::is_same<T, const wchar_t *>::value || std::is_same<T, wchar_t *>::value>>
+			{
+				static const int32_t kind = kind_string;
+				std::wstring chars;
+				std::vector<int32_t> offsets{ 0 };
+
+				static void append(std::wstring &chars, const std::wstring &text)
+				{
+					chars += text;
+				}
+
+				static void append(std::wstring &chars, const wchar_t *text)
+				{
+					chars += text;
+				}
+
+				template<class Row, size_t I>
+				column(array_view<const Row> rows, std::integral_constant<size_t, I>)
+				{
+					offsets.reserve(rows.size() + 1);
+					for (const auto &row : rows)
+					{
+						append(chars, std::get<I>(row));
+						offsets.push_back(checked_size<int32_t>(chars.size()));
+					}
+				}
+
+				value js() const
+				{
+					return value::array(value{ chars }, view(offsets.data(), offsets.size()));
+				}
+			};
+
+			static value driver()
+			{
+				static const char key = 0;
+				return context_data::current().get(&key, []
+				{
+					return RunScript(LR"==((function (target, count, kinds, columns, out) {
+	var argc = kinds.length, args = new Array(argc), results = out || new Array(count), i, k, c;
+	for (i = 0; i < count; ++i) {
+		for (k = 0; k < argc; ++k) {
+			c = columns[k];
+			switch (kinds[k]) {
+			case 0: args[k] = c[i]; break;
+			case 1: args[k] = c[i] !== 0; break;
+			default: args[k] = c[0].substring(c[1][i], c[1][i + 1]); break;
+			}
+		}
+		results[i] = target.apply(undefined, args);
+	}
+	return results;
+}))==", JS_SOURCE_CONTEXT_NONE, L"");
+				});
+			}
+
+			template<class... Args, size_t... I>
+			static value run(const value &target, array_view<const std::tuple<Args...>> rows, std::index_sequence<I...>, const value &out)
+			{
+				std::tuple<column<std::decay_t<Args>>...> columns{ column<std::decay_t<Args>>{ rows, std::integral_constant<size_t, I>{} }... };
+				const int32_t kinds[] = { column<std::decay_t<Args>>::kind..., 0 };
+				return driver()(nullptr, target, checked_size<int>(rows.size()), view(kinds, sizeof...(Args)),
+					value::array(std::get<I>(columns).js()...), out);
+			}
+
+			template<class R>
+			static std::vector<R> results(std::vector<R> &&out, std::true_type)
+			{
+				return std::move(out);
+			}
+
+			template<class R, class T>
+			static std::vector<R> results(std::vector<T> &&out, std::false_type)
+			{
+				std::vector<R> result;
+				result.reserve(out.size());
+				for (auto v : out)
+					result.push_back(static_cast<R>(v));
+				return result;
+			}
+
+		public:
+			template<class R, class... Args>
+			static std::enable_if_t<std::is_same<R, value>::value, value> call(const value &target, array_view<const std::tuple<Args...>> rows)
+			{
+				return run(target, rows, std::index_sequence_for<Args...>{}, value::undefined());
+			}
+
+			// arithmetic results are written by the driver straight into the returned vector, or converted from doubles
+			template<class R, class... Args>
+			static std::enable_if_t<std::is_arithmetic<R>::value, std::vector<R>> call(const value &target, array_view<const std::tuple<Args...>> rows)
+			{
+				using element_t = std::conditional_t<is_typed_array_element<R>::value, R, double>;
+				std::vector<element_t> out(rows.size());
+				run(target, rows, std::index_sequence_for<Args...>{}, view(out.data(), out.size()));
+				return results<R>(std::move(out), std::is_same<R, element_t>{});
+			}
+		};
+
+		template<class R, class Rows>
+		inline auto value::map_call(const Rows &rows) const
+		{
+			CBRIDGE_OPERATION("value::map_call");
+			using row_t = std::remove_const_t<std::remove_pointer_t<decltype(rows.data())>>;
+			return map_call_packer::call<R>(*this, array_view<const row_t>{ rows.data(), rows.size() });
+		}
+
+		// Column of a columnar_table holding one member of all rows
+		template<class T>
+		class table_column
+		{
+		public:
+			virtual ~table_column() = default;
+
+			// create an empty column for the same member
+			virtual std::unique_ptr<table_column> create() const = 0;
+			virtual const wchar_t *name() const noexcept = 0;
+			virtual void load(array_view<const T> rows) = 0;
+			virtual value js() = 0;
+			virtual void store(array_view<T> rows) const = 0;
+
+			// allocate storage for length records gathered by a script and return the array the script fills
+			virtual value gather(size_t length) = 0;
+			// copy gathered values into records. text is the joined text of a string member
+			virtual void scatter(const value &text, array_view<T> rows) const = 0;
+		};
+
+		// Numeric member, stored in a typed array. Types without a typed array equivalent are stored as doubles,
+		// bool as uint8_t
+		template<class T, class M>
+		class numeric_column : public table_column<T>
+		{
+			using element_t = std::conditional_t<std::is_same<M, bool>::value, uint8_t, std::conditional_t<is_typed_array_element<M>::value, M, double>>;
+
+			std::wstring name_;
+			M T::*field;
+			std::vector<element_t> data;
+
+			// integers without a typed array equivalent are stored as doubles, which scripts may set to NaN or to
+			// values out of the member's range
+			static M to_member(element_t v)
+			{
+				if constexpr (std::is_same<element_t, double>::value && std::is_integral<M>::value)
+				{
+					constexpr double upper = static_cast<double>(std::numeric_limits<M>::max() / 2 + 1) * 2.0;
+					constexpr double lower = std::is_signed<M>::value ? -upper : -1.0;
+					if (!(v < upper && (std::is_signed<M>::value ? v >= lower : v > lower)))
+						throw exception(JsErrorInvalidArgument);
+				}
+				return static_cast<M>(v);
+			}
+
+		public:
+			numeric_column(std::wstring name, M T::*field) :
+				name_{ std::move(name) },
+				field{ field }
+			{}
+
+			std::unique_ptr<table_column<T>> create() const override
+			{
+				return std::make_unique<numeric_column>(name_, field);
+			}
+
+			const wchar_t *name() const noexcept override
+			{
+				return name_.c_str();
+			}
+
+			void load(array_view<const T> rows) override
+			{
+				data.resize(rows.size());
+				for (size_t i = 0; i < rows.size(); ++i)
+					data[i] = static_cast<element_t>(rows[i].*field);
+			}
+
+			value js() override
+			{
+				if (data.empty())
+					return value::typed_array(typed_array_type<element_t>::value, 0);
+				return value::typed_array(typed_array_type<element_t>::value, value::array_buffer(data.data(), data.size() * sizeof(element_t)), 0, checked_size(data.size()));
+			}
+
+			void store(array_view<T> rows) const override
+			{
+				for (size_t i = 0; i < rows.size(); ++i)
+					rows[i].*field = to_member(data[i]);
+			}
+
+			value gather(size_t length) override
+			{
+				data.resize(length);
+				return js();
+			}
+
+			void scatter(const value &, array_view<T> rows) const override
+			{
+				store(rows);
+			}
+		};
+
+		// String member, dictionary encoded: { codes: Uint32Array, dictionary: [strings] }
+		template<class T>
+		class string_column : public table_column<T>
+		{
+			std::wstring name_;
+			std::wstring T::*field;
+			std::vector<uint32_t> codes;
+			std::vector<std::wstring> dictionary;
+			referenced_value dictionary_js;
+			std::vector<uint32_t> offsets;
+
+			// offsets are written by the script: each string must lie within the joined text
+			void check_offsets(size_t count, size_t length) const
+			{
+				if (offsets.size() <= count || offsets[count] > length)
+					throw exception(JsErrorInvalidArgument);
+				for (size_t i = 0; i < count; ++i)
+				{
+					if (offsets[i] > offsets[i + 1])
+						throw exception(JsErrorInvalidArgument);
+				}
+			}
+
+		public:
+			string_column(std::wstring name, std::wstring T::*field) :
+				name_{ std::move(name) },
+				field{ field }
+			{}
+
+			std::unique_ptr<table_column<T>> create() const override
+			{
+				return std::make_unique<string_column>(name_, field);
+			}
+
+			const wchar_t *name() const noexcept override
+			{
+				return name_.c_str();
+			}
+
+			void load(array_view<const T> rows) override
+			{
+				std::unordered_map<std::wstring, uint32_t> index;
+				codes.resize(rows.size());
+				dictionary.clear();
+				for (size_t i = 0; i < rows.size(); ++i)
+				{
+					auto result = index.emplace(rows[i].*field, static_cast<uint32_t>(dictionary.size()));
+					if (result.second)
+						dictionary.push_back(rows[i].*field);
+					codes[i] = result.first->second;
+				}
+			}
+
+			value js() override
+			{
+				auto strings = value::uninitialized_array(checked_size(dictionary.size()));
+				for (size_t i = 0; i < dictionary.size(); ++i)
+					strings.set_indexed(static_cast<int>(i), dictionary[i]);
+				dictionary_js = strings;
+
+				auto codes_js = codes.empty() ? value::typed_array(JsArrayTypeUint32, 0) :
+					value::typed_array(JsArrayTypeUint32, value::array_buffer(codes.data(), codes.size() * sizeof(uint32_t)), 0, checked_size(codes.size()));
+				return value::object()
+					.field(L"codes", codes_js)
+					.field(L"dictionary", strings);
+			}
+
+			// scripts may reorder codes and append strings to the dictionary
+			void store(array_view<T> rows) const override
+			{
+				std::vector<std::wstring> appended;
+				if (!dictionary_js.is_empty())
+				{
+					auto length = dictionary_js[L"length"].as<int>();
+					for (auto i = static_cast<int>(dictionary.size()); i < length; ++i)
+						appended.push_back(dictionary_js[value{ i }].as_string());
+				}
+				for (size_t i = 0; i < rows.size(); ++i)
+				{
+					auto code = codes[i];
+					if (code < dictionary.size())
+						rows[i].*field = dictionary[code];
+					else if (code - dictionary.size() < appended.size())
+						rows[i].*field = appended[code - dictionary.size()];
+					else
+						throw exception(JsErrorInvalidArgument);
+				}
+			}
+
+			// the script joins all strings and stores the start of each one: { offsets: Uint32Array }
+			value gather(size_t length) override
+			{
+				offsets.resize(length + 1);
+				return value::object()
+					.field(L"offsets", value::typed_array(JsArrayTypeUint32, value::array_buffer(offsets.data(), offsets.size() * sizeof(uint32_t)), 0, checked_size(offsets.size())));
+			}
+
+			void scatter(const value &text, array_view<T> rows) const override
+			{
+				if (rows.size() == 0)
+					return;
+#if defined(CBRIDGE_WCHAR_UTF16)
+				const wchar_t *ptr;
+				size_t length;
+				check(JsStringToPointer(text, &ptr, &length));
+				check_offsets(rows.size(), length);
+				for (size_t i = 0; i < rows.size(); ++i)
+					rows[i].*field = std::wstring{ ptr + offsets[i], ptr + offsets[i + 1] };
+#else
+				int length;
+				check(JsGetStringLength(text, &length));
+				check_offsets(rows.size(), static_cast<size_t>(length));
+				utf::buffer<char16_t> utf16{ static_cast<size_t>(length) };
+				size_t written;
+				check(JsCopyStringUtf16(text, 0, length, reinterpret_cast<uint16_t *>(utf16.data()), &written));
+				for (size_t i = 0; i < rows.size(); ++i)
+					rows[i].*field = utf::to_wstring(utf16.data() + offsets[i], offsets[i + 1] - offsets[i]);
+#endif
+			}
+		};
+
+		// Member descriptor of a columnar_table, created with member()
+		template<class T>
+		class column_member
+		{
+			std::shared_ptr<const table_column<T>> prototype;
+
+		public:
+			explicit column_member(std::shared_ptr<const table_column<T>> prototype) noexcept :
+				prototype{ std::move(prototype) }
+			{}
+
+			std::unique_ptr<table_column<T>> create() const
+			{
+				return prototype->create();
+			}
+
+			const wchar_t *name() const noexcept
+			{
+				return prototype->name();
+			}
+		};
+
+		// Member descriptor returned by member(), keeping the member's type for struct_view
+		template<class T, class M>
+		class typed_column_member : public column_member<T>
+		{
+			M T::*field_;
+
+		public:
+			typed_column_member(std::shared_ptr<const table_column<T>> prototype, M T::*field) noexcept :
+				column_member<T>{ std::move(prototype) },
+				field_{ field }
+			{}
+
+			M T::*field() const noexcept
+			{
+				return field_;
+			}
+		};
+
+		// Script that copies members of an array of objects into typed arrays in a single pass over the array
+		inline value gather_extractor()
+		{
+			static const char key = 0;
+			return context_data::current().get(&key, []
+			{
+				return RunScript(LR"==((function (rows, n, names, targets) {
+	var m = names.length, parts = [], texts = [], i, j;
+	for (j = 0; j < m; ++j)
+		parts[j] = targets[j].offsets !== undefined ? [] : null;
+	for (i = 0; i < n; ++i) {
+		var row = rows[i];
+		for (j = 0; j < m; ++j) {
+			var v = row[names[j]];
+			if (parts[j] === null)
+				targets[j][i] = v;
+			else
+				parts[j][i] = v == null ? "" : String(v);
+		}
+	}
+	for (j = 0; j < m; ++j) {
+		if (parts[j] !== null) {
+			var p = parts[j], offsets = targets[j].offsets, k = 0;
+			for (i = 0; i < n; ++i) {
+				offsets[i] = k;
+				k += p[i].length;
+			}
+			offsets[n] = k;
+			texts[j] = p.join("");
+		}
+	}
+	return texts;
+}))==", JS_SOURCE_CONTEXT_NONE, L"");
+			});
+		}
+
+		// Copy members of a JavaScript array of objects into records. Numeric members are converted as by assignment
+		// to a typed array, string members as by String(), with null and undefined becoming empty strings
+		template<class T>
+		inline std::vector<T> gather(const value &rows, std::initializer_list<column_member<T>> members)
+		{
+			CBRIDGE_OPERATION("gather");
+			auto length = rows[L"length"].as<int>();
+			if (length < 0)
+				throw exception(JsErrorInvalidArgument);
+
+			std::vector<std::unique_ptr<table_column<T>>> columns;
+			auto names = value::uninitialized_array(checked_size(members.size()));
+			auto targets = value::uninitialized_array(checked_size(members.size()));
+			for (const auto &m : members)
+			{
+				auto index = static_cast<int>(columns.size());
+				columns.push_back(m.create());
+				names.set_indexed(index, columns.back()->name());
+				targets.set_indexed(index, columns.back()->gather(static_cast<size_t>(length)));
+			}
+
+			// the script uses the length read here, so a getter or proxy cannot make it write past the typed arrays
+			auto texts = gather_extractor()(nullptr, rows, length, names, targets);
+			std::vector<T> result(static_cast<size_t>(length));
+			array_view<T> view{ result.data(), result.size() };
+			for (size_t i = 0; i < columns.size(); ++i)
+				columns[i]->scatter(texts[value{ static_cast<int>(i) }], view);
+			return result;
+		}
+
+		template<class T, class M>
+		inline typed_column_member<T, M> member(const wchar_t *name, M T::*field)
+		{
+			static_assert(std::is_arithmetic<M>::value && !std::is_same<M, char>::value && !std::is_same<M, wchar_t>::value,
+				"Table members must be numbers, bool or std::wstring");
+			return{ std::make_shared<numeric_column<T, M>>(name, field), field };
+		}
+
+		template<class T>
+		inline typed_column_member<T, std::wstring> member(const wchar_t *name, std::wstring T::*field)
+		{
+			return{ std::make_shared<string_column<T>>(name, field), field };
+		}
+
+		// Struct-of-arrays copy of a sequence of records. Scripts see an object with a length and a typed array per
+		// numeric member, referencing the table's storage, so the table must outlive the script's use of the object.
+		// Values modified by scripts can be stored back into records
+		template<class T>
+		class columnar_table
+		{
+			size_t length;
+			std::vector<std::unique_ptr<table_column<T>>> columns;
+
+		public:
+			columnar_table(array_view<const T> rows, std::initializer_list<column_member<T>> members) :
+				length{ rows.size() }
+			{
+				for (const auto &m : members)
+				{
+					columns.push_back(m.create());
+					columns.back()->load(rows);
+				}
+			}
+
+			size_t size() const noexcept
+			{
+				return length;
+			}
+
+			// construct JavaScript object: { length, member: TypedArray, string_member: { codes, dictionary } }
+			value object()
+			{
+				CBRIDGE_OPERATION("columnar_table::object");
+				auto result = value::object().field(L"length", value{ checked_size<int>(length) });
+				for (auto &c : columns)
+					result.field(c->name(), c->js());
+				return result;
+			}
+
+			// copy column values into records. rows must have the same size as the table
+			void store(array_view<T> rows) const
+			{
+				CBRIDGE_OPERATION("columnar_table::store");
+				if (rows.size() != length)
+					throw exception(JsErrorInvalidArgument);
+				for (const auto &c : columns)
+					c->store(rows);
+			}
+		};
+
+		// Record layouts of a binary document. Fields are laid out in declaration order with natural alignment,
+		// references, strings, vectors and arrays are stored as 32-bit offsets into the document
+		class binary_schema
+		{
+		public:
+			// field kinds, numbered as in the accessor script
+			enum class kind : uint8_t
+			{
+				int8, uint8, int16, uint16, int32, uint32, float32, float64, boolean,
+				string,	// UTF-16 text
+				record,	// reference to a record
+				vector,	// records stored inline
+				array,	// scalars, exposed as a typed array
+			};
+
+			using type_id = uint32_t;
+			using field_id = uint32_t;
+
+			struct field_info
+			{
+				std::wstring name;
+				kind field_kind;
+				kind element;	// element kind of an array
+				uint32_t offset;
+				type_id target;	// record type of a reference or a vector
+				type_id owner;	// record type the field belongs to
+			};
+
+			struct type_info
+			{
+				uint32_t size;
+				std::vector<field_id> fields;
+			};
+
+		private:
+			std::vector<type_info> types_;
+			std::vector<field_info> fields_;
+
+			field_id add(type_id type, const wchar_t *name, kind k, kind element, type_id target)
+			{
+				if (type >= types_.size())
+					throw exception(JsErrorInvalidArgument);
+				auto size = size_of(k);
+				auto &t = types_[type];
+				auto offset = (t.size + size - 1) & ~(size - 1);
+				t.size = offset + size;
+				t.fields.push_back(static_cast<field_id>(fields_.size()));
+				fields_.push_back({ name, k, element, offset, target, type });
+				return t.fields.back();
+			}
+
+		public:
+			// size of a field of the given kind. Non-scalar fields hold offsets
+			static uint32_t size_of(kind k) noexcept
+			{
+				switch (k)
+				{
+				case kind::int8: case kind::uint8: case kind::boolean: return 1;
+				case kind::int16: case kind::uint16: return 2;
+				case kind::float64: return 8;
+				default: return 4;
+				}
+			}
+
+			// add an empty record type
+			type_id record()
+			{
+				types_.push_back({ 0, {} });
+				return static_cast<type_id>(types_.size() - 1);
+			}
+
+			// add a scalar or a string field
+			field_id field(type_id type, const wchar_t *name, kind k)
+			{
+				if (k > kind::string)
+					throw exception(JsErrorInvalidArgument);
+				return add(type, name, k, k, 0);
+			}
+
+			// add a field referencing a record of the target type, or null
+			field_id reference(type_id type, const wchar_t *name, type_id target)
+			{
+				return add(type, name, kind::record, kind::record, target);
+			}
+
+			// add a field holding a vector of records of the target type
+			field_id vector(type_id type, const wchar_t *name, type_id target)
+			{
+				return add(type, name, kind::vector, kind::vector, target);
+			}
+
+			// add a field holding an array of scalars
+			field_id array(type_id type, const wchar_t *name, kind element)
+			{
+				if (element >= kind::string)
+					throw exception(JsErrorInvalidArgument);
+				return add(type, name, kind::array, element, 0);
+			}
+
+			const field_info &field_at(field_id field) const
+			{
+				if (field >= fields_.size())
+					throw exception(JsErrorInvalidArgument);
+				return fields_[field];
+			}
+
+			// record size, a multiple of 8 bytes so that records in vectors stay aligned
+			uint32_t size(type_id type) const
+			{
+				if (type >= types_.size())
+					throw exception(JsErrorInvalidArgument);
+				return (std::max(types_[type].size, 1u) + 7) & ~7u;
+			}
+
+			const std::vector<type_info> &types() const noexcept
+			{
+				return types_;
+			}
+		};
+
+		// Writes records into a binary document described by a schema. Records are referenced by their offsets, which
+		// stay valid while the document grows. Blocks are 8-byte aligned, strings, vectors and arrays start with a
+		// 32-bit count followed by 4 bytes of padding for vectors and arrays
+		class binary_builder
+		{
+		public:
+			using ref = uint32_t;
+
+			// records of a vector, stored one after another
+			struct records
+			{
+				ref first;
+				uint32_t count;
+				uint32_t stride;
+
+				ref operator[](uint32_t index) const noexcept
+				{
+					return first + index * stride;
+				}
+			};
+
+		private:
+			// allocated records: a single record or the records of a vector
+			struct block
+			{
+				binary_schema::type_id type;
+				uint32_t count;
+				uint32_t stride;
+			};
+
+			const binary_schema &schema;
+			std::vector<uint8_t> data;
+			std::map<ref, block> blocks;	// by offset of the first record
+
+			// true if r is the offset of a record of the given type
+			bool is_record(ref r, binary_schema::type_id type) const noexcept
+			{
+				auto it = blocks.upper_bound(r);
+				if (it == blocks.begin())
+					return false;
+				--it;
+				auto distance = r - it->first;
+				return it->second.type == type && distance % it->second.stride == 0 && distance / it->second.stride < it->second.count;
+			}
+
+			ref allocate(size_t size)
+			{
+				auto offset = data.size();
+				if (offset + size > std::numeric_limits<unsigned int>::max())
+					throw exception(JsErrorOutOfMemory);
+				data.resize(offset + ((size + 7) & ~static_cast<size_t>(7)));
+				return static_cast<ref>(offset);
+			}
+
+			uint8_t *at(ref r, const binary_schema::field_info &f, binary_schema::kind expected)
+			{
+				if (f.field_kind != expected || !is_record(r, f.owner))
+					throw exception(JsErrorInvalidArgument);
+				return &data[r + f.offset];
+			}
+
+			void store_offset(ref r, binary_schema::field_id field, binary_schema::kind expected, ref target)
+			{
+				auto p = at(r, schema.field_at(field), expected);
+				memcpy(p, &target, sizeof(target));
+			}
+
+			template<class T>
+			static void write(uint8_t *p, binary_schema::kind k, T v)
+			{
+				using kind = binary_schema::kind;
+				switch (k)
+				{
+				case kind::int8: { auto x = static_cast<int8_t>(v); memcpy(p, &x, sizeof(x)); break; }
+				case kind::uint8: { auto x = static_cast<uint8_t>(v); memcpy(p, &x, sizeof(x)); break; }
+				case kind::boolean: { uint8_t x = v ? 1 : 0; memcpy(p, &x, sizeof(x)); break; }
+				case kind::int16: { auto x = static_cast<int16_t>(v); memcpy(p, &x, sizeof(x)); break; }
+				case kind::uint16: { auto x = static_cast<uint16_t>(v); memcpy(p, &x, sizeof(x)); break; }
+				case kind::int32: { auto x = static_cast<int32_t>(v); memcpy(p, &x, sizeof(x)); break; }
+				case kind::uint32: { auto x = static_cast<uint32_t>(v); memcpy(p, &x, sizeof(x)); break; }
+				case kind::float32: { auto x = static_cast<float>(v); memcpy(p, &x, sizeof(x)); break; }
+				case kind::float64: { auto x = static_cast<double>(v); memcpy(p, &x, sizeof(x)); break; }
+				default: throw exception(JsErrorInvalidArgument);
+				}
+			}
+
+			// accessor classes for all record types, built by a script compiled once per context
+			static value generator()
+			{
+				static const char key = 0;
+				return context_data::current().get(&key, []
+				{
+					return RunScript(LR"==((function (buffer, types, rootType, rootOffset) {
+	var view = new DataView(buffer), units = new Uint16Array(buffer, 0, buffer.byteLength >> 1);
+	var arrays = [Int8Array, Uint8Array, Int16Array, Uint16Array, Int32Array, Uint32Array, Float32Array, Float64Array, Uint8Array];
+	function text(p) {
+		var n = view.getUint32(p, true), start = (p + 4) >> 1, s = "";
+		for (var i = 0; i < n; i += 8192)
+			s += String.fromCharCode.apply(null, units.subarray(start + i, start + Math.min(n, i + 8192)));
+		return s;
+	}
+	function Records(ctor, first, length, stride) {
+		this.$ctor = ctor;
+		this.$first = first;
+		this.$stride = stride;
+		this.length = length;
+	}
+	Records.prototype.get = function (i) {
+		return i >= 0 && i < this.length ? new this.$ctor(this.$first + i * this.$stride) : undefined;
+	};
+	if (typeof Symbol === "function" && Symbol.iterator)
+		Records.prototype[Symbol.iterator] = function () {
+			var self = this, i = 0;
+			return { next: function () { return i < self.length ? { value: self.get(i++), done: false } : { value: undefined, done: true }; } };
+		};
+	var ctors = types.map(function () { return function (offset) { this.$offset = offset; }; });
+	types.forEach(function (t, index) {
+		var proto = ctors[index].prototype;
+		t.fields.forEach(function (f) {
+			var k = f.offset, get;
+			function offset(o) { return view.getUint32(o + k, true); }
+			switch (f.kind) {
+			case 0: get = function () { return view.getInt8(this.$offset + k); }; break;
+			case 1: get = function () { return view.getUint8(this.$offset + k); }; break;
+			case 2: get = function () { return view.getInt16(this.$offset + k, true); }; break;
+			case 3: get = function () { return view.getUint16(this.$offset + k, true); }; break;
+			case 4: get = function () { return view.getInt32(this.$offset + k, true); }; break;
+			case 5: get = function () { return view.getUint32(this.$offset + k, true); }; break;
+			case 6: get = function () { return view.getFloat32(this.$offset + k, true); }; break;
+			case 7: get = function () { return view.getFloat64(this.$offset + k, true); }; break;
+			case 8: get = function () { return view.getUint8(this.$offset + k) !== 0; }; break;
+			case 9: get = function () { var p = offset(this.$offset); return p ? text(p) : null; }; break;
+			case 10: (function (ctor) {
+					get = function () { var p = offset(this.$offset); return p ? new ctor(p) : null; };
+				})(ctors[f.target]); break;
+			case 11: (function (ctor, stride) {
+					get = function () { var p = offset(this.$offset); return p ? new Records(ctor, p + 8, view.getUint32(p, true), stride) : null; };
+				})(ctors[f.target], types[f.target].size); break;
+			case 12: (function (ctor) {
+					get = function () { var p = offset(this.$offset); return p ? new ctor(buffer, p + 8, view.getUint32(p, true)) : null; };
+				})(arrays[f.element]); break;
+			}
+			Object.defineProperty(proto, f.name, { get: get, enumerable: true });
+		});
+	});
+	return new ctors[rootType](rootOffset);
+}))==", JS_SOURCE_CONTEXT_NONE, L"");
+				});
+			}
+
+		public:
+			explicit binary_builder(const binary_schema &schema) :
+				schema{ schema },
+				data(8)	// offset 0 is a null reference
+			{}
+
+			// allocate a zero-initialized record
+			ref record(binary_schema::type_id type)
+			{
+				auto stride = schema.size(type);
+				auto r = allocate(stride);
+				blocks.emplace(r, block{ type, 1, stride });
+				return r;
+			}
+
+			// assign a scalar field
+			template<class T, class = std::enable_if_t<std::is_arithmetic<T>::value>>
+			void set(ref r, binary_schema::field_id field, T v)
+			{
+				const auto &f = schema.field_at(field);
+				if (f.field_kind >= binary_schema::kind::string)
+					throw exception(JsErrorInvalidArgument);
+				write(at(r, f, f.field_kind), f.field_kind, v);
+			}
+
+			// assign a string field
+			void set(ref r, binary_schema::field_id field, const wchar_t *text, size_t length)
+			{
+				at(r, schema.field_at(field), binary_schema::kind::string);
+#if defined(CBRIDGE_WCHAR_UTF16)
+				auto units = reinterpret_cast<const char16_t *>(text);
+				auto count = length;
+#else
+				utf::utf16_string utf16{ text, length };
+				auto units = utf16.data();
+				auto count = utf16.size();
+#endif
+				auto p = allocate(4 + count * sizeof(char16_t));
+				auto n = static_cast<uint32_t>(count);
+				memcpy(&data[p], &n, sizeof(n));
+				memcpy(&data[p + 4], units, count * sizeof(char16_t));
+				store_offset(r, field, binary_schema::kind::string, p);
+			}
+
+			void set(ref r, binary_schema::field_id field, const std::wstring &text)
+			{
+				set(r, field, text.c_str(), text.size());
+			}
+
+			void set(ref r, binary_schema::field_id field, const wchar_t *text)
+			{
+				set(r, field, text, wcslen(text));
+			}
+
+			// assign a reference field. 0 is null, other targets must be records of the field's target type
+			void link(ref r, binary_schema::field_id field, ref target)
+			{
+				if (target != 0 && !is_record(target, schema.field_at(field).target))
+					throw exception(JsErrorInvalidArgument);
+				store_offset(r, field, binary_schema::kind::record, target);
+			}
+
+			// allocate zero-initialized records of a vector field
+			records vector(ref r, binary_schema::field_id field, uint32_t count)
+			{
+				const auto &f = schema.field_at(field);
+				at(r, f, binary_schema::kind::vector);
+				auto stride = schema.size(f.target);
+				auto p = allocate(8 + static_cast<size_t>(count) * stride);
+				memcpy(&data[p], &count, sizeof(count));
+				if (count != 0)
+					blocks.emplace(p + 8, block{ f.target, count, stride });
+				store_offset(r, field, binary_schema::kind::vector, p);
+				return{ p + 8, count, stride };
+			}
+
+			// copy values into an array field, converting them to the element kind
+			template<class T>
+			void array(ref r, binary_schema::field_id field, array_view<const T> values)
+			{
+				const auto &f = schema.field_at(field);
+				at(r, f, binary_schema::kind::array);
+				auto size = binary_schema::size_of(f.element);
+				auto count = checked_size(values.size());
+				auto p = allocate(8 + static_cast<size_t>(count) * size);
+				memcpy(&data[p], &count, sizeof(count));
+				for (unsigned int i = 0; i < count; ++i)
+					write(&data[p + 8 + i * size], f.element, values[i]);
+				store_offset(r, field, binary_schema::kind::array, p);
+			}
+
+			size_t size() const noexcept
+			{
+				return data.size();
+			}
+
+			// move the document into an ArrayBuffer and return an accessor for the root record. Accessors decode fields
+			// when they are read; the builder is empty afterwards
+			value finish(binary_schema::type_id root_type, ref root)
+			{
+				CBRIDGE_OPERATION("binary_builder::finish");
+				if (!is_record(root, root_type))
+					throw exception(JsErrorInvalidArgument);
+
+				const auto &types = schema.types();
+				auto types_js = value::uninitialized_array(checked_size(types.size()));
+				for (size_t t = 0; t < types.size(); ++t)
+				{
+					auto fields_js = value::uninitialized_array(checked_size(types[t].fields.size()));
+					for (size_t i = 0; i < types[t].fields.size(); ++i)
+					{
+						const auto &f = schema.field_at(types[t].fields[i]);
+						fields_js.set_indexed(static_cast<int>(i), value::object()
+							.field(L"name", f.name)
+							.field(L"kind", static_cast<int>(f.field_kind))
+							.field(L"element", static_cast<int>(f.element))
+							.field(L"offset", static_cast<int>(f.offset))
+							.field(L"target", static_cast<int>(f.target)));
+					}
+					types_js.set_indexed(static_cast<int>(t), value::object()
+						.field(L"size", static_cast<int>(schema.size(static_cast<binary_schema::type_id>(t))))
+						.field(L"fields", fields_js));
+				}
+
+				auto owned = std::make_unique<std::vector<uint8_t>>(std::move(data));
+				data.assign(8, 0);
+				blocks.clear();
+				JsValueRef buffer;
+				check(JsCreateExternalArrayBuffer(owned->data(), checked_size(owned->size()), [](void *state)
+				{
+					delete static_cast<std::vector<uint8_t> *>(state);
+				}, owned.get(), &buffer));
+				owned.release();	// will be deleted later in callback
+				return generator()(nullptr, value{ buffer }, types_js, static_cast<int>(root_type), static_cast<double>(root));
+			}
+		};
+
+		// Member of a struct_view: its name and a function returning its offset in a record and its typed array
+		// type, -1 for bool. Converted from member(), which fails to compile for members without a typed array type
+		template<class T>
+		class struct_member
+		{
+			std::wstring name_;
+			std::function<std::pair<size_t, int>(const T &record)> layout_;
+
+		public:
+			template<class M>
+			struct_member(const typed_column_member<T, M> &m) :
+				name_{ m.name() },
+				layout_{ [field = m.field()](const T &record)
+				{
+					auto offset = reinterpret_cast<const char *>(&(record.*field)) - reinterpret_cast<const char *>(&record);
+					return std::pair<size_t, int>{ static_cast<size_t>(offset), std::is_same<M, bool>::value ? -1 : static_cast<int>(typed_array_type<std::conditional_t<std::is_same<M, bool>::value, uint8_t, M>>::value) };
+				} }
+			{
+				static_assert(std::is_same<M, bool>::value || is_typed_array_element<M>::value,
+					"struct_view members must be bool or have a typed array equivalent");
+			}
+
+			const std::wstring &name() const noexcept
+			{
+				return name_;
+			}
+
+			std::pair<size_t, int> layout(const T &record) const
+			{
+				return layout_(record);
+			}
+		};
+
+		// key identifying a view class of T with a given layout, the same for all calls with the same member list
+		template<class T>
+		inline const void *struct_view_key(const std::wstring &layout)
+		{
+			static std::mutex lock;
+			static std::unordered_set<std::wstring> layouts;
+			std::lock_guard<std::mutex> guard{ lock };
+			return &*layouts.insert(layout).first;
+		}
+
+		// Script that builds a view class from a list of { name, offset, type } descriptions. Accessors are compiled
+		// with constant offsets, so reads are plain DataView calls the JIT can inline
+		inline value struct_view_builder()
+		{
+			static const char key = 0;
+			return context_data::current().get(&key, []
+			{
+				return RunScript(LR"==((function (fields) {
+	var methods = ["Int8", "Uint8", "Uint8", "Int16", "Uint16", "Int32", "Uint32", "Float32", "Float64"];
+	function View(buffer) {
+		Object.defineProperty(this, "$view", { value: new DataView(buffer) });
+	}
+	fields.forEach(function (f) {
+		var get, set;
+		if (f.type < 0) {
+			get = new Function("return this.$view.getUint8(" + f.offset + ") !== 0;");
+			set = new Function("v", "this.$view.setUint8(" + f.offset + ", v ? 1 : 0);");
+		} else {
+			get = new Function("return this.$view.get" + methods[f.type] + "(" + f.offset + ", true);");
+			set = new Function("v", "this.$view.set" + methods[f.type] + "(" + f.offset + ", v, true);");
+		}
+		Object.defineProperty(View.prototype, f.name, { get: get, set: set, enumerable: true });
+	});
+	return function (buffer) { return new View(buffer); };
+}))==", JS_SOURCE_CONTEXT_NONE, L"");
+			});
+		}
+
+		// Construct an object whose properties read and write numeric and bool members of a native struct directly
+		// in its memory, without calling back into C++. The view class is built once per type, member list and
+		// context. The struct must outlive the object
+		template<class T>
+		inline value struct_view(T *object, std::initializer_list<struct_member<std::remove_cv_t<T>>> members)
+		{
+			static_assert(std::is_standard_layout<T>::value, "struct_view requires a standard layout type");
+			CBRIDGE_OPERATION("struct_view");
+			std::vector<std::pair<size_t, int>> layouts;
+			layouts.reserve(members.size());
+			std::wstring signature;
+			for (const auto &m : members)
+			{
+				layouts.push_back(m.layout(*object));
+				signature.append(m.name()).append(1, L'\0').append(std::to_wstring(layouts.back().first)).append(1, L':').append(std::to_wstring(layouts.back().second)).append(1, L'\0');
+			}
+
+			auto create = context_data::current().get(struct_view_key<T>(signature), [&]
+			{
+				auto fields = value::uninitialized_array(checked_size(members.size()));
+				int index = 0;
+				for (const auto &m : members)
+				{
+					const auto &layout = layouts[index];
+					fields.set_indexed(index++, value::object()
+						.field(L"name", m.name())
+						.field(L"offset", static_cast<int>(layout.first))
+						.field(L"type", layout.second));
+				}
+				return struct_view_builder()(nullptr, fields);
+			});
+			return create(nullptr, value::array_buffer(object, sizeof(T)));
+		}
+
+		// Precompiled property path, such as L"config.servers[2].name". The text is parsed once, property identifiers
+		// are resolved on first evaluation and kept alive, so the path must not outlive the runtime it is evaluated in.
+		// Evaluation does not throw: missing segments and engine errors are reported in the returned result
+		class path
+		{
+			struct segment
+			{
+				std::wstring name;
+				int index;
+				bool indexed;
+				JsRef ref;	// property identifier or index value
+			};
+
+			std::vector<segment> segments;
+			bool bound{ false };
+
+			// undefined and null of the context of the last evaluation. The context is referenced to keep them valid
+			JsContextRef context{ JS_INVALID_REFERENCE };
+			JsValueRef undefined{ JS_INVALID_REFERENCE };
+			JsValueRef null{ JS_INVALID_REFERENCE };
+
+			void parse(const wchar_t *text)
+			{
+				const wchar_t *p = text;
+				while (*p)
+				{
+					if (*p == L'[')
+					{
+						const wchar_t *begin = ++p;
+						int index = 0;
+						for (; *p >= L'0' && *p <= L'9'; ++p)
+						{
+							if (index > (std::numeric_limits<int>::max() - (*p - L'0')) / 10)
+								throw exception(JsErrorInvalidArgument);
+							index = index * 10 + (*p - L'0');
+						}
+						if (p == begin || *p != L']')
+							throw exception(JsErrorInvalidArgument);
+						segments.push_back({ {}, index, true, JS_INVALID_REFERENCE });
+						if (*++p && *p != L'.' && *p != L'[')
+							throw exception(JsErrorInvalidArgument);
+					}
+					else
+					{
+						const wchar_t *begin = p;
+						while (*p && *p != L'.' && *p != L'[')
+							++p;
+						if (p == begin)
+							throw exception(JsErrorInvalidArgument);
+						segments.push_back({ { begin, p }, 0, false, JS_INVALID_REFERENCE });
+					}
+
+					if (*p == L'.' && *++p == 0)
+						throw exception(JsErrorInvalidArgument);
+				}
+			}
+
+			JsErrorCode bind()
+			{
+				if (bound)
+					return JsNoError;
+				for (auto &s : segments)
+				{
+					JsRef ref;
+					auto error = s.indexed ? JsIntToNumber(s.index, &ref) : get_property_id(s.name.c_str(), &ref);
+					if (succeeded(error))
+						error = JsAddRef(ref, nullptr);
+					if (failed(error))
+					{
+						release();
+						return error;
+					}
+					s.ref = ref;
+				}
+				bound = true;
+				return JsNoError;
+			}
+
+			// fetch undefined and null when evaluated in a context other than the previous one
+			JsErrorCode bind_context()
+			{
+				JsContextRef current;
+				auto error = JsGetCurrentContext(&current);
+				if (failed(error) || current == context)
+					return error;
+
+				JsValueRef u, n;
+				error = JsGetUndefinedValue(&u);
+				if (succeeded(error))
+					error = JsGetNullValue(&n);
+				if (succeeded(error))
+					error = JsAddRef(current, nullptr);
+				if (failed(error))
+					return error;
+
+				release_context();
+				context = current;
+				undefined = u;
+				null = n;
+				return JsNoError;
+			}
+
+			void release_context() noexcept
+			{
+				if (context != JS_INVALID_REFERENCE)
+					JsRelease(context, nullptr);
+				context = undefined = null = JS_INVALID_REFERENCE;
+			}
+
+			void release() noexcept
+			{
+				for (auto &s : segments)
+				{
+					if (s.ref != JS_INVALID_REFERENCE)
+						JsRelease(s.ref, nullptr);
+					s.ref = JS_INVALID_REFERENCE;
+				}
+				bound = false;
+				release_context();
+			}
+
+			static JsErrorCode lookup(JsValueRef object, const segment &s, JsValueRef *result) noexcept
+			{
+				return s.indexed ? JsGetIndexedProperty(object, s.ref, result) : JsGetProperty(object, s.ref, result);
+			}
+
+			static void clear_exception(JsErrorCode error) noexcept
+			{
+				if (error == JsErrorScriptException)
+				{
+					JsValueRef ignored;
+					JsGetAndClearException(&ignored);
+				}
+			}
+
+		public:
+			static const size_t npos = static_cast<size_t>(-1);
+
+			struct result
+			{
+				value target;			// value found or assigned
+				size_t missing;			// index of the first segment that resolved to undefined or null, npos if none
+				JsErrorCode error;		// engine error, JsNoError if none
+
+				explicit operator bool() const noexcept
+				{
+					return error == JsNoError && missing == npos;
+				}
+			};
+
+		private:
+			// resolve the first count segments starting from root. Returns false and fills r if resolution stops early
+			bool walk(const value &root, size_t count, JsValueRef &current, result &r)
+			{
+				r.error = bind();
+				if (succeeded(r.error))
+					r.error = bind_context();
+				if (failed(r.error))
+					return false;
+
+				current = root;
+				if (current == JS_INVALID_REFERENCE || current == undefined || current == null)
+				{
+					r.missing = 0;
+					return false;
+				}
+
+				for (size_t i = 0; i < count; ++i)
+				{
+					JsValueRef next;
+					auto error = lookup(current, segments[i], &next);
+					if (error == JsErrorArgumentNotObject)
+					{
+						// primitive values, such as strings, get their properties through a wrapper object
+						JsValueRef object;
+						error = JsConvertValueToObject(current, &object);
+						if (succeeded(error))
+							error = lookup(object, segments[i], &next);
+					}
+					if (failed(error))
+					{
+						clear_exception(error);
+						r.error = error;
+						r.missing = i;
+						return false;
+					}
+					if (next == undefined || (next == null && i + 1 < segments.size()))
+					{
+						r.missing = i;
+						r.target = value{ next };
+						return false;
+					}
+					current = next;
+				}
+				return true;
+			}
+
+			// conversions used by get_as
+			static JsErrorCode convert(JsValueRef v, value &result) noexcept
+			{
+				result = value{ v };
+				return JsNoError;
+			}
+
+			static JsErrorCode convert(JsValueRef v, bool &result) noexcept
+			{
+				return JsBooleanToBool(v, &result);
+			}
+
+			static JsErrorCode convert(JsValueRef v, std::wstring &result)
+			{
+#if defined(CBRIDGE_WCHAR_UTF16)
+				const wchar_t *ptr;
+				size_t length;
+				auto error = JsStringToPointer(v, &ptr, &length);
+				if (succeeded(error))
+					result.assign(ptr, length);
+				return error;
+#else
+				int length;
+				auto error = JsGetStringLength(v, &length);
+				if (failed(error))
+					return error;
+				utf::buffer<char16_t> utf16{ static_cast<size_t>(length) };
+				size_t written;
+				error = JsCopyStringUtf16(v, 0, length, reinterpret_cast<uint16_t *>(utf16.data()), &written);
+				if (succeeded(error))
+					result = utf::to_wstring(utf16.data(), written);
+				return error;
+#endif
+			}
+
+			template<class T>
+			static std::enable_if_t<std::is_arithmetic<T>::value || std::is_enum<T>::value, JsErrorCode> convert(JsValueRef v, T &result) noexcept
+			{
+				double number;
+				auto error = JsNumberToDouble(v, &number);
+				if (succeeded(error))
+					result = static_cast<T>(static_cast<std::conditional_t<std::is_enum<T>::value, int64_t, T>>(number));
+				return error;
+			}
+
+		public:
+			explicit path(const wchar_t *text)
+			{
+				parse(text);
+			}
+
+			path(path &&o) noexcept :
+				segments{ std::move(o.segments) },
+				bound{ o.bound },
+				context{ o.context },
+				undefined{ o.undefined },
+				null{ o.null }
+			{
+				o.segments.clear();
+				o.bound = false;
+				o.context = o.undefined = o.null = JS_INVALID_REFERENCE;
+			}
+
+			path(const path &) = delete;
+			path &operator =(const path &) = delete;
+
+			~path()
+			{
+				release();
+			}
+
+			// number of segments
+			size_t size() const noexcept
+			{
+				return segments.size();
+			}
+
+			// return the name of a segment, for indexed segments the index in brackets
+			std::wstring segment_name(size_t i) const
+			{
+				const auto &s = segments[i];
+				return s.indexed ? L"[" + std::to_wstring(s.index) + L"]" : s.name;
+			}
+
+			// resolve the path starting from root
+			result get(const value &root)
+			{
+				CBRIDGE_OPERATION("path::get");
+				result r{ value{}, npos, JsNoError };
+				JsValueRef current;
+				if (walk(root, segments.size(), current, r))
+					r.target = value{ current };
+				return r;
+			}
+
+			// resolve the path starting from root and convert the result. Conversion failure is reported
+			// as an error, out is only changed on success
+			template<class T>
+			result get_as(const value &root, T &out)
+			{
+				CBRIDGE_OPERATION("path::get");
+				auto r = get(root);
+				if (r)
+				{
+					T converted;
+					r.error = convert(r.target, converted);
+					if (succeeded(r.error))
+						out = std::move(converted);
+				}
+				return r;
+			}
+
+			// assign the last segment of the path. All preceding segments must exist
+			result set(const value &root, const value &v)
+			{
+				CBRIDGE_OPERATION("path::set");
+				result r{ v, npos, JsNoError };
+				JsValueRef current;
+				if (segments.empty())
+					r.error = JsErrorInvalidArgument;
+				else if (walk(root, segments.size() - 1, current, r))
+				{
+					const auto &last = segments.back();
+					r.error = last.indexed ? JsSetIndexedProperty(current, last.ref, v) : JsSetProperty(current, last.ref, v, true);
+					clear_exception(r.error);
+				}
+				return r;
+			}
+		};
+
+		// Exposes native memory of any size to scripts as an object with fixed-size ArrayBuffer segments created on
+		// demand: { length, segmentSize, segmentCount, segment(i) }. The object keeps only the working_set most recently
+		// used segments referenced. Segments reference the memory directly, so it must outlive the runtime
+		class segmented_buffer : public value
+		{
+			static value factory()
+			{
+				static const char key = 0;
+				return context_data::current().get(&key, []
+				{
+					return RunScript(LR"==((function (create, count, limit) {
+	var cache = [], order = [];
+	return function segment(i) {
+		if (i !== (i >>> 0) || i >= count)
+			throw new RangeError("segment index out of range");
+		var s = cache[i];
+		if (s === undefined) {
+			s = cache[i] = create(i);
+			if (order.length >= limit)
+				delete cache[order.shift()];
+		} else
+			order.splice(order.indexOf(i), 1);
+		order.push(i);
+		return s;
+	};
+}))==", JS_SOURCE_CONTEXT_NONE, L"");
+				});
+			}
+
+			static value create(void *data, uint64_t size, unsigned int segment_size, unsigned int working_set)
+			{
+				if (!segment_size || !working_set)
+					throw exception(JsErrorInvalidArgument);
+
+				auto count = (size + segment_size - 1) / segment_size;
+				auto base = static_cast<BYTE *>(data);
+				auto segment = function<1>([base, size, segment_size](unsigned int i)
+				{
+					auto offset = static_cast<uint64_t>(i) * segment_size;
+					return array_buffer(base + offset, static_cast<size_t>(std::min<uint64_t>(segment_size, size - offset)));
+				});
+
+				return object()
+					.field(L"length", static_cast<double>(size))
+					.field(L"segmentSize", segment_size)
+					.field(L"segmentCount", static_cast<double>(count))
+					.field(L"segment", factory()(nullptr, segment, static_cast<double>(count), working_set));
+			}
+
+		public:
+			segmented_buffer(void *data, uint64_t size, unsigned int segment_size = 64u << 20, unsigned int working_set = 16) :
+				value{ create(data, size, segment_size, working_set) }
+			{}
+		};
+
+		// Batched output for script logging. Console methods transcode their arguments to UTF-8 straight into a lock-free
+		// single-producer ring buffer; a background thread passes the accumulated text to the sink in batches. Writers never
+		// block: messages that do not fit into the buffer are dropped and counted. The producer side is the thread running
+		// the runtime, so use one console per runtime
+		class console
+		{
+		public:
+			// receives a batch of complete UTF-8 lines
+			using sink_t = std::function<void(const char *text, size_t size)>;
+
+			struct statistics
+			{
+				uint64_t messages;				// messages written to the buffer
+				uint64_t dropped_messages;		// messages dropped because the buffer was full
+				uint64_t dropped_characters;	// UTF-16 code units in dropped messages
+				uint64_t batches;				// sink invocations
+			};
+
+		private:
+			enum level : char
+			{
+				level_log,
+				level_info,
+				level_warn,
+				level_error,
+				level_debug,
+			};
+
+			// record: u32 length, level, UTF-8 text; records are 4-byte aligned
+			static const uint32_t wrap_marker = 0xFFFFFFFF;
+
+			struct state
+			{
+				std::unique_ptr<char[]> ring;
+				size_t capacity;
+				std::atomic<uint64_t> head{ 0 };	// advanced by the producer
+				char padding[64];					// keep producer and consumer positions on different cache lines
+				std::atomic<uint64_t> tail{ 0 };	// advanced by the consumer
+				std::atomic<uint64_t> flushed{ 0 };	// position passed to the sink
+
+				std::atomic<uint64_t> messages{ 0 };
+				std::atomic<uint64_t> dropped_messages{ 0 };
+				std::atomic<uint64_t> dropped_characters{ 0 };
+				std::atomic<uint64_t> batches{ 0 };
+
+				sink_t sink;
+				std::chrono::milliseconds interval;
+				std::mutex wait_lock;
+				std::condition_variable wake;		// signaled to the consumer
+				std::condition_variable drained;	// signaled by the consumer after each pass
+				bool flush_requested{ false };		// guarded by wait_lock
+				std::atomic<bool> closed{ false };
+
+				state(sink_t sink, size_t size, std::chrono::milliseconds interval) :
+					capacity{ 4096 },
+					sink{ std::move(sink) },
+					interval{ interval }
+				{
+					while (capacity < size)
+						capacity *= 2;
+					ring = std::make_unique<char[]>(capacity);
+				}
+			};
+
+			std::shared_ptr<state> state_;
+			std::thread consumer;
+
+			static size_t align(size_t size) noexcept
+			{
+				return (size + 3) & ~static_cast<size_t>(3);
+			}
+
+			static void write(state &s, level lvl, array_view<const value> args)
+			{
+				// collect UTF-16 text of all arguments, borrowing string storage where the engine allows it
+				thread_local std::vector<std::pair<const char16_t *, size_t>> parts;
+				parts.clear();
+				size_t units = 0;
+#if defined(CBRIDGE_WCHAR_UTF16)
+				for (const auto &arg : args)
+				{
+					JsValueRef text;
+					check(JsConvertValueToString(arg, &text));
+					const wchar_t *ptr;
+					size_t length;
+					check(JsStringToPointer(text, &ptr, &length));
+					parts.emplace_back(reinterpret_cast<const char16_t *>(ptr), length);
+					units += length + 1;
+				}
+#else
+				thread_local std::u16string joined;
+				joined.clear();
+				for (const auto &arg : args)
+				{
+					JsValueRef text;
+					check(JsConvertValueToString(arg, &text));
+					int length;
+					check(JsGetStringLength(text, &length));
+					if (!joined.empty())
+						joined.push_back(u' ');
+					auto offset = joined.size();
+					joined.resize(offset + static_cast<size_t>(length));
+					size_t written;
+					check(JsCopyStringUtf16(text, 0, length, reinterpret_cast<uint16_t *>(&joined[offset]), &written));
+					joined.resize(offset + written);
+				}
+				parts.emplace_back(joined.data(), joined.size());
+				units = joined.size() + 1;
+#endif
+
+				// reserve room for the worst case: 3 UTF-8 bytes per UTF-16 code unit plus level and separators
+				auto needed = align(sizeof(uint32_t) + 1 + 3 * units + 1);
+				auto head = s.head.load(std::memory_order_relaxed);
+				auto used = head - s.tail.load(std::memory_order_acquire);
+				auto pos = static_cast<size_t>(head & (s.capacity - 1));
+				auto skip = needed > s.capacity - pos ? s.capacity - pos : 0;
+				if (s.closed.load(std::memory_order_relaxed) || needed + skip > s.capacity - used)
+				{
+					s.dropped_messages.fetch_add(1, std::memory_order_relaxed);
+					s.dropped_characters.fetch_add(units, std::memory_order_relaxed);
+					return;
+				}
+				if (skip)
+				{
+					memcpy(&s.ring[pos], &wrap_marker, sizeof(wrap_marker));
+					head += skip;
+					pos = 0;
+				}
+
+				auto start = &s.ring[pos + sizeof(uint32_t)];
+				auto p = start;
+				*p++ = lvl;
+				for (size_t i = 0; i < parts.size(); ++i)
+				{
+					if (i)
+						*p++ = ' ';
+					p += utf::utf16_to_utf8(parts[i].first, parts[i].second, p);
+				}
+				*p++ = '\n';
+
+				auto length = static_cast<uint32_t>(p - start);
+				memcpy(&s.ring[pos], &length, sizeof(length));
+				s.head.store(head + align(sizeof(uint32_t) + length), std::memory_order_release);
+				s.messages.fetch_add(1, std::memory_order_relaxed);
+			}
+
+			static const char *prefix(char lvl) noexcept
+			{
+				switch (lvl)
+				{
+				case level_warn:
+					return "warning: ";
+				case level_error:
+					return "error: ";
+				case level_debug:
+					return "debug: ";
+				default:
+					return "";
+				}
+			}
+
+			static void drain(state &s, std::string &batch)
+			{
+				auto head = s.head.load(std::memory_order_acquire);
+				auto tail = s.tail.load(std::memory_order_relaxed);
+				batch.clear();
+				while (tail != head)
+				{
+					auto pos = static_cast<size_t>(tail & (s.capacity - 1));
+					uint32_t length;
+					memcpy(&length, &s.ring[pos], sizeof(length));
+					if (length == wrap_marker)
+					{
+						tail += s.capacity - pos;
+						continue;
+					}
+					const char *record = &s.ring[pos + sizeof(uint32_t)];
+					batch += prefix(record[0]);
+					batch.append(record + 1, length - 1);
+					tail += align(sizeof(uint32_t) + length);
+				}
+				s.tail.store(tail, std::memory_order_release);
+
+				if (!batch.empty())
+				{
+					try
+					{
+						s.sink(batch.data(), batch.size());
+					}
+					catch (...)
+					{
+					}
+					s.batches.fetch_add(1, std::memory_order_relaxed);
+				}
+				s.flushed.store(tail, std::memory_order_release);
+			}
+
+			static void run(std::shared_ptr<state> s)
+			{
+				std::string batch;
+				for (;;)
+				{
+					auto closing = s->closed.load(std::memory_order_acquire);
+					drain(*s, batch);
+					std::unique_lock<std::mutex> lock{ s->wait_lock };
+					s->drained.notify_all();
+					if (closing)
+						break;
+					s->wake.wait_for(lock, s->interval, [&] { return s->flush_requested || s->closed.load(std::memory_order_acquire); });
+					s->flush_requested = false;
+				}
+			}
+
+			static sink_t fd_sink(int fd)
+			{
+				return [fd](const char *text, size_t size)
+				{
+					while (size)
+					{
+#if defined(_WIN32)
+						auto written = _write(fd, text, static_cast<unsigned int>(std::min<size_t>(size, INT_MAX)));
+#else
+						auto written = ::write(fd, text, size);
+#endif
+						if (written < 0 && errno == EINTR)
+							continue;
+						if (written <= 0)
+							break;
+						text += written;
+						size -= static_cast<size_t>(written);
+					}
+				};
+			}
+
+		public:
+			// pass batches to a sink
+			explicit console(sink_t sink, size_t capacity = 1 << 20, std::chrono::milliseconds interval = std::chrono::milliseconds{ 50 }) :
+				state_{ std::make_shared<state>(std::move(sink), capacity, interval) },
+				consumer{ &run, state_ }
+			{}
+
+			// write batches to a file descriptor
+			explicit console(int fd, size_t capacity = 1 << 20, std::chrono::milliseconds interval = std::chrono::milliseconds{ 50 }) :
+				console{ fd_sink(fd), capacity, interval }
+			{}
+
+			console(const console &) = delete;
+			console &operator =(const console &) = delete;
+
+			// writes remaining messages and stops the background thread. Console methods called afterwards drop their messages
+			~console()
+			{
+				{
+					std::lock_guard<std::mutex> guard{ state_->wait_lock };
+					state_->closed = true;
+				}
+				state_->wake.notify_one();
+				consumer.join();
+			}
+
+			// construct JavaScript object with log, info, warn, error and debug methods
+			value object() const
+			{
+				auto s = state_;
+				auto method = [&](level lvl)
+				{
+					return value::variadic_function([s, lvl](array_view<const value> args)
+					{
+						write(*s, lvl, args);
+					});
+				};
+
+				return value::object()
+					.field(L"log", method(level_log))
+					.field(L"info", method(level_info))
+					.field(L"warn", method(level_warn))
+					.field(L"error", method(level_error))
+					.field(L"debug", method(level_debug));
+			}
+
+			// wait until all messages written so far have been passed to the sink
+			void flush()
+			{
+				auto target = state_->head.load(std::memory_order_acquire);
+				std::unique_lock<std::mutex> lock{ state_->wait_lock };
+				state_->flush_requested = true;
+				state_->wake.notify_one();
+				state_->drained.wait(lock, [&] { return state_->flushed.load(std::memory_order_acquire) >= target; });
+			}
+
+			statistics stats() const noexcept
+			{
+				return{
+					state_->messages.load(std::memory_order_relaxed),
+					state_->dropped_messages.load(std::memory_order_relaxed),
+					state_->dropped_characters.load(std::memory_order_relaxed),
+					state_->batches.load(std::memory_order_relaxed)
+				};
+			}
+		};
+
+		// Input range over a JavaScript iterable. The iterator is obtained with Symbol.iterator and advanced with
+		// its next method; property identifiers are looked up once per range. Elements are produced lazily, so
+		// begin may only be called once
+		class iteration
+		{
+			value iterator_;
+			value next;
+			JsPropertyIdRef done_id;
+			JsPropertyIdRef value_id;
+			value current;
+			bool started{ false };
+			bool finished{ false };
+
+			static value iterator_symbol()
+			{
+				static const char key = 0;
+				return context_data::current().get(&key, []
+				{
+					return value::global()[L"Symbol"][L"iterator"];
+				});
+			}
+
+			void advance()
+			{
+				CBRIDGE_PROFILE_SCRIPT();
+				JsValueRef self = iterator_;
+				JsValueRef result;
+				check(JsCallFunction(next, &self, 1, &result));
+				JsValueRef done;
+				check(JsGetProperty(result, done_id, &done));
+				check(JsConvertValueToBoolean(done, &done));
+				bool done_;
+				check(JsBooleanToBool(done, &done_));
+				if (done_)
+				{
+					finished = true;
+					current = value{};
+					return;
+				}
+				JsValueRef element;
+				check(JsGetProperty(result, value_id, &element));
+				current = value{ element };
+			}
+
+		public:
+			class iterator
+			{
+				iteration *owner;
+
+				bool at_end() const noexcept
+				{
+					return !owner || owner->finished;
+				}
+
+			public:
+				using iterator_category = std::input_iterator_tag;
+				using value_type = value;
+				using difference_type = std::ptrdiff_t;
+				using pointer = const value *;
+				using reference = const value &;
+
+				explicit iterator(iteration *owner = nullptr) noexcept :
+					owner{ owner }
+				{}
+
+				reference operator *() const noexcept
+				{
+					return owner->current;
+				}
+
+				pointer operator ->() const noexcept
+				{
+					return &owner->current;
+				}
+
+				iterator &operator ++()
+				{
+					owner->advance();
+					return *this;
+				}
+
+				void operator ++(int)
+				{
+					owner->advance();
+				}
+
+				bool operator ==(const iterator &other) const noexcept
+				{
+					return at_end() == other.at_end();
+				}
+
+				bool operator !=(const iterator &other) const noexcept
+				{
+					return !(*this == other);
+				}
+			};
+
+			explicit iteration(const value &iterable)
+			{
+				JsPropertyIdRef iterator_id;
+				check(JsGetPropertyIdFromSymbol(iterator_symbol(), &iterator_id));
+				iterator_ = iterable.call(iterator_id);
+				next = iterator_[L"next"];
+				done_id = property_id(L"done");
+				value_id = property_id(L"value");
+			}
+
+			iterator begin()
+			{
+				if (!started)
+				{
+					started = true;
+					advance();
+				}
+				return iterator{ this };
+			}
+
+			iterator end() noexcept
+			{
+				return iterator{};
+			}
+		};
+
+		inline iteration value::iterate() const
+		{
+			CBRIDGE_OPERATION("value::iterate");
+			return iteration{ *this };
+		}
+
+		template<class Range>
+		inline value value::iterable(Range range, size_t prefetch)
+		{
+			CBRIDGE_OPERATION("value::iterable");
+			using iterator_t = decltype(std::begin(std::declval<Range &>()));
+			using sentinel_t = decltype(std::end(std::declval<Range &>()));
+			struct state
+			{
+				Range range;
+				iterator_t current;
+				sentinel_t end;
+
+				explicit state(Range &&range) :
+					range(std::move(range)),
+					current(std::begin(this->range)),
+					end(std::end(this->range))
+				{}
+			};
+
+			if (!prefetch)
+				throw exception(JsErrorInvalidArgument);
+
+			static const char key = 0;
+			auto wrapper = context_data::current().get(&key, []
+			{
+				return RunScript(LR"==((function (fill, size) {
+	var batch = [], index = 0, last = false;
+	var iterator = {
+		next: function () {
+			if (index === batch.length) {
+				if (last)
+					return { value: undefined, done: true };
+				batch = fill();
+				index = 0;
+				last = batch.length < size;
+				if (batch.length === 0)
+					return { value: undefined, done: true };
+			}
+			return { value: batch[index++], done: false };
+		},
+		return: function (result) {
+			batch = [];
+			index = 0;
+			last = true;
+			return { value: result, done: true };
+		}
+	};
+	iterator[Symbol.iterator] = function () { return this; };
+	return iterator;
+}))==", JS_SOURCE_CONTEXT_NONE, L"");
+			});
+
+			auto s = std::make_shared<state>(std::move(range));
+			auto fill = function<0>([s, prefetch]
+			{
+				auto batch = uninitialized_array();
+				for (int i = 0; static_cast<size_t>(i) < prefetch && s->current != s->end; ++i, ++s->current)
+					batch.set_indexed(i, value{ *s->current });
+				return batch;
+			});
+			return wrapper(nullptr, fill, checked_size<int>(prefetch));
+		}
+
+		// Usage of a module declared with lazy_module
+		struct module_usage
+		{
+			std::wstring name;
+			uint64_t declared;	// number of lazy_module calls, normally one per context
+			uint64_t installed;	// number of times a script touched the module and its installer ran
+		};
+
+		class module_registry
+		{
+			struct counters
+			{
+				std::atomic<uint64_t> declared{ 0 };
+				std::atomic<uint64_t> installed{ 0 };
+			};
+
+			std::mutex lock;
+			std::map<std::wstring, counters, std::less<>> modules;
+
+		public:
+			static module_registry &instance()
+			{
+				static module_registry registry;
+				return registry;
+			}
+
+			// return counters of a module. Addresses are stable, so callers may keep them
+			counters &get(const wchar_t *name)
+			{
+				std::lock_guard<std::mutex> guard{ lock };
+				auto it = modules.find(name);
+				if (it == modules.end())
+					it = modules.emplace(std::piecewise_construct, std::forward_as_tuple(name), std::forward_as_tuple()).first;
+				return it->second;
+			}
+
+			std::vector<module_usage> snapshot()
+			{
+				std::vector<module_usage> result;
+				std::lock_guard<std::mutex> guard{ lock };
+				for (const auto &item : modules)
+					result.push_back({ item.first, item.second.declared.load(std::memory_order_relaxed), item.second.installed.load(std::memory_order_relaxed) });
+				return result;
+			}
+		};
+
+		// Define a global property that builds its value on first access. The installer is called without arguments
+		// and returns the module object; the property is then replaced with the returned value
+		template<class Installer>
+		inline void lazy_module(const wchar_t *name, Installer installer)
+		{
+			auto &counters = module_registry::instance().get(name);
+			counters.declared.fetch_add(1, std::memory_order_relaxed);
+			value::global().lazy_field(name, [&counters, installer = std::move(installer)]
+			{
+				counters.installed.fetch_add(1, std::memory_order_relaxed);
+				return value{ installer() };
+			});
+		}
+
+		// return usage of all modules declared so far, sorted by name
+		inline std::vector<module_usage> module_stats()
+		{
+			return module_registry::instance().snapshot();
 		}
+
+#if defined(CBRIDGE_PROFILER)
+		// Sampling profiler of script code. A timer thread periodically requests an asynchronous break of the runtime,
+		// and the break handler records the script stack together with the native callback that was active when the
+		// break was requested. Breaks are only requested while the bridge runs script or a native callback on the
+		// runtime's thread. The runtime runs in debug mode while profiling, which disables some optimizations.
+		// start, stop and the accessors must be called on the runtime's thread while no script is running
+		class profiler
+		{
+			JsRuntimeHandle runtime_;
+			std::chrono::microseconds interval;
+			std::thread timer;
+			std::mutex lock;
+			std::condition_variable wake;
+			bool stopping{ false };
+			bool running{ false };
+
+			profiler_activity *activity{ nullptr };	// of the runtime's thread
+			std::atomic<const std::wstring *> pending_callback{ nullptr };
+			std::atomic<bool> pending{ false };
+			std::atomic<uint32_t> requested{ 0 };	// idle count of the runtime's thread when the break was requested
+			std::atomic<uint64_t> skipped_{ 0 };
+			uint64_t samples_{ 0 };
+			uint64_t stale_{ 0 };
+			uint64_t errors_{ 0 };
+
+			std::unordered_map<std::wstring, uint64_t> stacks;
+			std::unordered_map<int, std::wstring> scripts;
+
+			static std::wstring string_property(const value &object, const wchar_t *name)
+			{
+				auto v = object[name].get();
+				return v.is_string() ? v.as_string() : std::wstring{};
+			}
+
+			const std::wstring &script_name(int id)
+			{
+				auto it = scripts.find(id);
+				if (it == scripts.end())
+				{
+					JsValueRef list;
+					check(JsDiagGetScripts(&list));
+					value scripts_js{ list };
+					auto length = scripts_js[L"length"].as<int>();
+					for (int i = 0; i < length; ++i)
+					{
+						auto script = scripts_js[value{ i }].get();
+						auto name = string_property(script, L"fileName");
+						auto script_id = script[L"scriptId"].as<int>();
+						scripts[script_id] = name.empty() ? L"script" + std::to_wstring(script_id) : name;
+					}
+					it = scripts.emplace(id, L"script" + std::to_wstring(id)).first;
+				}
+				return it->second;
+			}
+
+			// "name (file:line)" of the function executing in a stack frame, without ';' which separates frames
+			std::wstring frame_label(const value &frame)
+			{
+				JsValueRef function;
+				check(JsDiagGetObjectFromHandle(frame[L"functionHandle"].as<int>(), &function));
+				value f{ function };
+				auto name = string_property(f, L"name");
+				auto label = (name.empty() ? L"(anonymous)" : name) + L" (" + script_name(f[L"scriptId"].as<int>()) + L':' +
+					std::to_wstring(f[L"line"].as<int>() + 1) + L')';
+				std::replace(label.begin(), label.end(), L';', L':');
+				return label;
+			}
+
+			void sample()
+			{
+				JsValueRef trace;
+				check(JsDiagGetStackTrace(&trace));
+				value frames{ trace };
+				std::wstring stack;
+				for (auto i = frames[L"length"].as<int>() - 1; i >= 0; --i)
+				{
+					if (!stack.empty())
+						stack += L';';
+					stack += frame_label(frames[value{ i }].get());
+				}
+				if (auto callback = pending_callback.exchange(nullptr, std::memory_order_relaxed))
+				{
+					if (!stack.empty())
+						stack += L';';
+					stack += L"[native] " + *callback;
+				}
+				++stacks[stack];
+				++samples_;
+			}
+
+			static void CHAKRA_CALLBACK on_debug_event(JsDiagDebugEvent event, JsValueRef, void *state)
+			{
+				if (event != JsDiagDebugEventAsyncBreak)
+					return;
+				auto self = static_cast<profiler *>(state);
+				// the thread became idle since the request, so the script or callback that was running has returned and
+				// the break is taken by a later script
+				auto idle_count = static_cast<uint32_t>(self->activity->state.load(std::memory_order_relaxed) >> 32);
+				if (idle_count != self->requested.load(std::memory_order_relaxed))
+				{
+					self->pending_callback.store(nullptr, std::memory_order_relaxed);
+					++self->stale_;
+				}
+				else
+				{
+					try
+					{
+						self->sample();
+					}
+					catch (...)
+					{
+						++self->errors_;
+					}
+				}
+				self->pending.store(false, std::memory_order_release);
+			}
+
+			void run_timer()
+			{
+				std::unique_lock<std::mutex> guard{ lock };
+				while (!wake.wait_for(guard, interval, [this] { return stopping; }))
+				{
+					// no request while the runtime's thread is idle, or while a break has not been taken yet because
+					// no script has run since the last request
+					auto state = activity->state.load(std::memory_order_relaxed);
+					if ((state & 0xffffffff) == 0 || pending.exchange(true, std::memory_order_acquire))
+					{
+						skipped_.fetch_add(1, std::memory_order_relaxed);
+						continue;
+					}
+					pending_callback.store(activity->callback.load(std::memory_order_relaxed), std::memory_order_relaxed);
+					requested.store(static_cast<uint32_t>(state >> 32), std::memory_order_relaxed);
+					JsDiagRequestAsyncBreak(runtime_);
+				}
+			}
+
+		public:
+			explicit profiler(JsRuntimeHandle runtime, std::chrono::microseconds interval = std::chrono::milliseconds{ 1 }) noexcept :
+				runtime_{ runtime },
+				interval{ interval }
+			{}
+
+			profiler(const profiler &) = delete;
+			profiler &operator =(const profiler &) = delete;
+
+			~profiler()
+			{
+				stop();
+			}
+
+			// put the runtime into debug mode and start sampling
+			void start()
+			{
+				if (running)
+					return;
+				check(JsDiagStartDebugging(runtime_, &on_debug_event, this));
+				activity = &profiled_activity();
+				running = true;
+				stopping = false;
+				timer = std::thread{ [this] { run_timer(); } };
+			}
+
+			void stop() noexcept
+			{
+				if (!running)
+					return;
+				{
+					std::lock_guard<std::mutex> guard{ lock };
+					stopping = true;
+				}
+				wake.notify_one();
+				timer.join();
+				void *state;
+				JsDiagStopDebugging(runtime_, &state);
+				pending.store(false);
+				running = false;
+			}
+
+			// number of recorded samples
+			uint64_t samples() const noexcept
+			{
+				return samples_;
+			}
+
+			// number of timer ticks without a request, because no script was running or no script ran since the
+			// previous request
+			uint64_t skipped() const noexcept
+			{
+				return skipped_.load(std::memory_order_relaxed);
+			}
+
+			// number of breaks discarded because the script or callback running when they were requested returned
+			// before they were taken
+			uint64_t stale() const noexcept
+			{
+				return stale_;
+			}
+
+			// number of breaks in which the stack could not be read
+			uint64_t errors() const noexcept
+			{
+				return errors_;
+			}
+
+			void reset() noexcept
+			{
+				stacks.clear();
+				samples_ = 0;
+				stale_ = 0;
+				errors_ = 0;
+				skipped_.store(0);
+			}
+
+			// samples in folded stack format, one "outermost;...;innermost count" line per distinct stack, in UTF-8.
+			// The output is accepted by flamegraph.pl and tools converting to pprof
+			std::string folded() const
+			{
+				std::vector<std::pair<std::wstring, uint64_t>> sorted{ stacks.begin(), stacks.end() };
+				std::sort(sorted.begin(), sorted.end());
+				std::string result;
+				for (const auto &s : sorted)
+				{
+					result += utf::to_utf8(s.first.c_str(), s.first.size());
+					result += ' ';
+					result += std::to_string(s.second);
+					result += '\n';
+				}
+				return result;
+			}
+		};
+#endif
 	}
 
 	// Bring several items into jsc namespace
 	using details::value;
 	using details::referenced_value;
+	using details::array_view;
+	using details::access_hint;
 	using details::exception;
 	using details::runtime;
 	using details::context;
@@ -1411,6 +5442,30 @@ namespace jsc
 	using details::ParseScript;
 	using details::ParseScriptWithAttributes;
 	using details::ExperimentalApiRunModule;
+	using details::RunSerializedScript;
+	using details::script_source;
+	using details::precompiled_script;
+	using details::precompile;
+	using details::batch_builder;
+	using details::path;
+	using details::segmented_buffer;
+	using details::console;
+	using details::iteration;
+	using details::error_registry;
+	using details::register_error;
+	using details::slot;
+	using details::module_usage;
+	using details::lazy_module;
+	using details::module_stats;
+	using details::columnar_table;
+	using details::member;
+	using details::gather;
+	using details::binary_schema;
+	using details::binary_builder;
+	using details::struct_view;
+#if defined(CBRIDGE_PROFILER)
+	using details::profiler;
+#endif
 }
 
 #if !defined(CBRIDGE_NO_GLOBAL_NAMESPACE)
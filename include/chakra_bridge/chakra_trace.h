@@ -0,0 +1,1385 @@
+//-------------------------------------------------------------------------------------------------------
+// Copyright (C) 2016 HHD Software Ltd.
+// Written by Alexander Bessonov
+//
+// Licensed under the MIT license. See LICENSE.txt file in the project root for full license information.
+//-------------------------------------------------------------------------------------------------------
+
+#pragma once
+
+// Engine call tracing and counters.
+// When CBRIDGE_TRACE or CBRIDGE_COUNTERS is defined before including chakra_bridge.h, every ChakraCore function called
+// by the library goes through a shim declared in this file. While recording is active, the shim writes API identifier,
+// arguments, results and duration of each call to a binary trace file. The trace may later be replayed against a local
+// runtime with jsc::trace::replay to see where the time goes.
+// With CBRIDGE_COUNTERS, the shim also counts engine calls per bridge operation, see jsc::counters::snapshot.
+
+// STL
+#include <string>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <algorithm>
+#include <unordered_map>
+#include <type_traits>
+#include <utility>
+#include <cstdio>
+#include <cstdint>
+#include <cstring>
+#include <cwchar>
+
+// ChakraCore
+#include <ChakraCore/inc/chakracommon.h>
+
+// Bridge
+#include "chakra_transcode.h"
+
+// List of traced ChakraCore functions. New entries must be appended to keep trace files compatible
+#define CBRIDGE_TRACE_APIS_COMMON(X) \
+	X(JsCreateRuntime) \
+	X(JsDisposeRuntime) \
+	X(JsCreateContext) \
+	X(JsGetCurrentContext) \
+	X(JsSetCurrentContext) \
+	X(JsGetRuntime) \
+	X(JsGetContextData) \
+	X(JsSetContextData) \
+	X(JsAddRef) \
+	X(JsRelease) \
+	X(JsSetObjectBeforeCollectCallback) \
+	X(JsGetUndefinedValue) \
+	X(JsGetNullValue) \
+	X(JsGetTrueValue) \
+	X(JsGetFalseValue) \
+	X(JsBoolToBoolean) \
+	X(JsBooleanToBool) \
+	X(JsDoubleToNumber) \
+	X(JsIntToNumber) \
+	X(JsNumberToDouble) \
+	X(JsNumberToInt) \
+	X(JsConvertValueToNumber) \
+	X(JsConvertValueToString) \
+	X(JsConvertValueToObject) \
+	X(JsGetValueType) \
+	X(JsGetPrototype) \
+	X(JsGetGlobalObject) \
+	X(JsCreateObject) \
+	X(JsCreateExternalObject) \
+	X(JsGetExternalData) \
+	X(JsGetProperty) \
+	X(JsSetProperty) \
+	X(JsDefineProperty) \
+	X(JsGetIndexedProperty) \
+	X(JsSetIndexedProperty) \
+	X(JsCreateArray) \
+	X(JsCreateExternalArrayBuffer) \
+	X(JsCreateTypedArray) \
+	X(JsGetTypedArrayInfo) \
+	X(JsGetTypedArrayStorage) \
+	X(JsCreateFunction) \
+	X(JsCallFunction) \
+	X(JsCreateError) \
+	X(JsCreateRangeError) \
+	X(JsHasException) \
+	X(JsGetAndClearException) \
+	X(JsSetException) \
+	X(JsRunScript) \
+	X(JsParseScript) \
+	X(JsParseScriptWithAttributes) \
+	X(JsExperimentalApiRunModule) \
+// end of macro
+
+#if defined(CBRIDGE_WCHAR_UTF16)
+#define CBRIDGE_TRACE_APIS_PLATFORM(X) \
+	X(JsPointerToString) \
+	X(JsStringToPointer) \
+	X(JsGetPropertyIdFromName) \
+// end of macro
+#else
+#define CBRIDGE_TRACE_APIS_PLATFORM(X) \
+	X(JsCreateStringUtf16) \
+	X(JsCopyStringUtf16) \
+	X(JsGetStringLength) \
+	X(JsCreatePropertyId) \
+// end of macro
+#endif
+
+// functions used by later additions to the library
+#define CBRIDGE_TRACE_APIS_ADDED(X) \
+	X(JsSerializeScript) \
+	X(JsRunSerializedScript) \
+	X(JsGetPropertyIdFromSymbol) \
+	X(JsConvertValueToBoolean) \
+	X(JsConstructObject) \
+	X(JsCreateSymbol) \
+// end of macro
+
+#define CBRIDGE_TRACE_APIS(X) \
+	CBRIDGE_TRACE_APIS_COMMON(X) \
+	CBRIDGE_TRACE_APIS_PLATFORM(X) \
+	CBRIDGE_TRACE_APIS_ADDED(X) \
+// end of macro
+
+namespace jsc
+{
+	namespace details
+	{
+		namespace counters
+		{
+			// engine calls made on behalf of a bridge operation
+			struct operation_counters
+			{
+				const char *operation;
+				uint64_t invocations;	// outermost invocations of the operation
+				uint64_t engine_calls;	// ChakraCore calls made by these invocations
+			};
+
+			// Counters of the calling thread. Engine calls are attributed to the outermost active operation, calls made
+			// outside of any operation are attributed to "(direct)"
+			class thread_counters
+			{
+				std::vector<operation_counters> entries{ { "(direct)", 0, 0 } };
+				std::unordered_map<const char *, size_t> index;
+				size_t current{ 0 };
+				bool in_operation{ false };
+
+			public:
+				static thread_counters &instance()
+				{
+					static thread_local thread_counters c;
+					return c;
+				}
+
+				// returns false if another operation is already active
+				bool enter(const char *operation)
+				{
+					if (in_operation)
+						return false;
+					auto it = index.find(operation);
+					if (it == index.end())
+					{
+						it = index.emplace(operation, entries.size()).first;
+						entries.push_back({ operation, 0, 0 });
+					}
+					current = it->second;
+					in_operation = true;
+					++entries[current].invocations;
+					return true;
+				}
+
+				void leave() noexcept
+				{
+					current = 0;
+					in_operation = false;
+				}
+
+				// native callbacks invoked by script start attribution afresh
+				bool suspend() noexcept
+				{
+					auto was = in_operation;
+					leave();
+					return was;
+				}
+
+				void resume(const char *operation) noexcept
+				{
+					auto it = index.find(operation);
+					current = it == index.end() ? 0 : it->second;
+					in_operation = true;
+				}
+
+				const char *operation() const noexcept
+				{
+					return entries[current].operation;
+				}
+
+				void count() noexcept
+				{
+					++entries[current].engine_calls;
+				}
+
+				std::vector<operation_counters> snapshot() const
+				{
+					// the same operation name may come from several translation units
+					std::vector<operation_counters> result;
+					for (const auto &e : entries)
+					{
+						auto it = std::find_if(result.begin(), result.end(), [&](const operation_counters &r) { return strcmp(r.operation, e.operation) == 0; });
+						if (it == result.end())
+							result.push_back(e);
+						else
+						{
+							it->invocations += e.invocations;
+							it->engine_calls += e.engine_calls;
+						}
+					}
+					result.erase(std::remove_if(result.begin(), result.end(), [](const operation_counters &r) { return r.engine_calls == 0 && r.invocations == 0; }), result.end());
+					std::sort(result.begin(), result.end(), [](const operation_counters &a, const operation_counters &b) { return a.engine_calls > b.engine_calls; });
+					return result;
+				}
+
+				void reset() noexcept
+				{
+					for (auto &e : entries)
+						e.invocations = e.engine_calls = 0;
+				}
+			};
+
+			// marks the scope of a bridge operation
+			class operation_scope
+			{
+				bool outermost;
+
+			public:
+				explicit operation_scope(const char *operation) :
+					outermost{ thread_counters::instance().enter(operation) }
+				{}
+
+				operation_scope(const operation_scope &) = delete;
+				operation_scope &operator =(const operation_scope &) = delete;
+
+				~operation_scope()
+				{
+					if (outermost)
+						thread_counters::instance().leave();
+				}
+			};
+
+			// suspends attribution to the calling operation while a native callback runs
+			class callback_scope
+			{
+				const char *operation;
+				bool suspended;
+
+			public:
+				callback_scope() noexcept :
+					operation{ thread_counters::instance().operation() },
+					suspended{ thread_counters::instance().suspend() }
+				{}
+
+				callback_scope(const callback_scope &) = delete;
+				callback_scope &operator =(const callback_scope &) = delete;
+
+				~callback_scope()
+				{
+					if (suspended)
+						thread_counters::instance().resume(operation);
+				}
+			};
+
+			inline void count_engine_call() noexcept
+			{
+				thread_counters::instance().count();
+			}
+
+			// return counters of the calling thread
+			inline std::vector<operation_counters> snapshot()
+			{
+				return thread_counters::instance().snapshot();
+			}
+
+			// zero counters of the calling thread
+			inline void reset() noexcept
+			{
+				thread_counters::instance().reset();
+			}
+		}
+
+		namespace trace
+		{
+			enum class api : uint16_t
+			{
+#define CBRIDGE_TRACE_ENUM(name) name,
+				CBRIDGE_TRACE_APIS(CBRIDGE_TRACE_ENUM)
+#undef CBRIDGE_TRACE_ENUM
+				count
+			};
+
+			inline const char *api_name(api id) noexcept
+			{
+				static const char *names[] =
+				{
+#define CBRIDGE_TRACE_NAME(name) #name,
+					CBRIDGE_TRACE_APIS(CBRIDGE_TRACE_NAME)
+#undef CBRIDGE_TRACE_NAME
+				};
+				return id < api::count ? names[static_cast<size_t>(id)] : "<unknown>";
+			}
+
+			// Trace file format. All values are stored in native byte order.
+			// file:    "CBTR" u32 version, records
+			// record:  u64 sequence, u16 api, u16 operand count, u32 error code, u64 duration (ns), operands
+			// operand: u8 tag, payload
+			enum tag : uint8_t
+			{
+				tag_handle = 'H',		// u64 handle passed to the function
+				tag_out = 'O',			// u64 handle returned by the function
+				tag_integer = 'I',		// i64
+				tag_double = 'D',		// f64
+				tag_text = 'S',			// u32 length, UTF-16 code units
+				tag_text8 = 'U',		// u32 length, UTF-8 code units
+				tag_array = 'A',		// u16 count, u64 handles
+				tag_scratch = 'X',		// u32 size of an output buffer not tracked by replay
+				tag_inout = 'N',		// i64 value of an in/out integer parameter before the call
+				tag_callback = 'C',		// callback function pointer
+				tag_opaque = 'P',		// host pointer
+				tag_buffer = 'B',		// u64 size of host memory block
+				tag_serialized = 'Z',	// u64 address and u64 size of a serialized script buffer, size is 0 when the script is run
+			};
+
+			const uint32_t file_magic = 0x52544243;	// "CBTR"
+			const uint32_t file_version = 2;
+
+			// record serialization
+			class record_writer
+			{
+				std::vector<unsigned char> data;
+
+			public:
+				template<class T>
+				void put(const T &v)
+				{
+					auto p = reinterpret_cast<const unsigned char *>(&v);
+					data.insert(data.end(), p, p + sizeof(T));
+				}
+
+				void put_bytes(const void *p, size_t size)
+				{
+					auto b = static_cast<const unsigned char *>(p);
+					data.insert(data.end(), b, b + size);
+				}
+
+				void clear() noexcept
+				{
+					data.clear();
+				}
+
+				const std::vector<unsigned char> &bytes() const noexcept
+				{
+					return data;
+				}
+			};
+
+			// operands of traced calls. arg() returns the argument passed to ChakraCore, write() is called after the call
+			struct in_t
+			{
+				JsRef handle;
+
+				JsRef arg() const noexcept
+				{
+					return handle;
+				}
+
+				void write(record_writer &w) const
+				{
+					w.put(tag_handle);
+					w.put(static_cast<uint64_t>(reinterpret_cast<uintptr_t>(handle)));
+				}
+			};
+
+			template<class T>
+			struct out_t
+			{
+				T *ptr;
+
+				T *arg() const noexcept
+				{
+					return ptr;
+				}
+
+				void write(record_writer &w) const
+				{
+					w.put(tag_out);
+					w.put(static_cast<uint64_t>(ptr ? reinterpret_cast<uintptr_t>(*ptr) : 0));
+				}
+			};
+
+			template<class T>
+			struct scalar_t
+			{
+				T v;
+
+				T arg() const noexcept
+				{
+					return v;
+				}
+
+				void write(record_writer &w) const
+				{
+					write(w, std::is_floating_point<T>{});
+				}
+
+				void write(record_writer &w, std::true_type) const
+				{
+					w.put(tag_double);
+					w.put(static_cast<double>(v));
+				}
+
+				void write(record_writer &w, std::false_type) const
+				{
+					w.put(tag_integer);
+					w.put(static_cast<int64_t>(v));
+				}
+			};
+
+			template<class T>
+			struct scratch_t
+			{
+				T *ptr;
+				size_t size;
+
+				T *arg() const noexcept
+				{
+					return ptr;
+				}
+
+				void write(record_writer &w) const
+				{
+					w.put(tag_scratch);
+					w.put(static_cast<uint32_t>(ptr ? size : 0));
+				}
+			};
+
+			template<class T>
+			struct inout_t
+			{
+				T *ptr;
+				int64_t before;
+
+				T *arg() const noexcept
+				{
+					return ptr;
+				}
+
+				void write(record_writer &w) const
+				{
+					w.put(tag_inout);
+					w.put(before);
+				}
+			};
+
+			template<class F>
+			struct callback_t
+			{
+				F f;
+
+				F arg() const noexcept
+				{
+					return f;
+				}
+
+				void write(record_writer &w) const
+				{
+					w.put(tag_callback);
+				}
+			};
+
+			struct opaque_t
+			{
+				void *ptr;
+
+				void *arg() const noexcept
+				{
+					return ptr;
+				}
+
+				void write(record_writer &w) const
+				{
+					w.put(tag_opaque);
+				}
+			};
+
+			template<class T>
+			struct buffer_t
+			{
+				T *ptr;
+				size_t size;
+
+				T *arg() const noexcept
+				{
+					return ptr;
+				}
+
+				void write(record_writer &w) const
+				{
+					w.put(tag_buffer);
+					w.put(static_cast<uint64_t>(size));
+				}
+			};
+
+			struct serialized_t
+			{
+				BYTE *ptr;
+				size_t size;
+
+				BYTE *arg() const noexcept
+				{
+					return ptr;
+				}
+
+				void write(record_writer &w) const
+				{
+					w.put(tag_serialized);
+					w.put(static_cast<uint64_t>(reinterpret_cast<uintptr_t>(ptr)));
+					w.put(static_cast<uint64_t>(size));
+				}
+			};
+
+			template<class Char>
+			struct text_t
+			{
+				const Char *ptr;
+				size_t length;
+
+				const Char *arg() const noexcept
+				{
+					return ptr;
+				}
+
+				void write(record_writer &w) const
+				{
+					w.put(tag_text);
+					write_units(w, ptr, std::integral_constant<bool, sizeof(Char) == sizeof(char16_t)>{});
+				}
+
+				template<class T>
+				void write_units(record_writer &w, const T *p, std::true_type) const
+				{
+					w.put(static_cast<uint32_t>(length));
+					w.put_bytes(p, length * sizeof(char16_t));
+				}
+
+				template<class T>
+				void write_units(record_writer &w, const T *p, std::false_type) const
+				{
+					std::u16string utf16(length * 2, u'\0');
+					utf16.resize(utf::utf32_to_utf16(reinterpret_cast<const char32_t *>(p), length, &utf16[0]));
+					w.put(static_cast<uint32_t>(utf16.size()));
+					w.put_bytes(utf16.data(), utf16.size() * sizeof(char16_t));
+				}
+			};
+
+			struct text8_t
+			{
+				const char *ptr;
+				size_t length;
+
+				const char *arg() const noexcept
+				{
+					return ptr;
+				}
+
+				void write(record_writer &w) const
+				{
+					w.put(tag_text8);
+					w.put(static_cast<uint32_t>(length));
+					w.put_bytes(ptr, length);
+				}
+			};
+
+			struct array_t
+			{
+				JsValueRef *ptr;
+				unsigned short count;
+
+				JsValueRef *arg() const noexcept
+				{
+					return ptr;
+				}
+
+				void write(record_writer &w) const
+				{
+					w.put(tag_array);
+					w.put(static_cast<uint16_t>(count));
+					for (unsigned short i = 0; i < count; ++i)
+						w.put(static_cast<uint64_t>(reinterpret_cast<uintptr_t>(ptr[i])));
+				}
+			};
+
+			// operand constructors
+			inline in_t in(JsRef handle) noexcept
+			{
+				return{ handle };
+			}
+
+			template<class T>
+			inline out_t<T> out(T *ptr) noexcept
+			{
+				return{ ptr };
+			}
+
+			template<class T>
+			inline scalar_t<T> scalar(T v) noexcept
+			{
+				return{ v };
+			}
+
+			template<class T>
+			inline scratch_t<T> scratch(T *ptr, size_t size = sizeof(T)) noexcept
+			{
+				return{ ptr, size };
+			}
+
+			template<class T>
+			inline inout_t<T> inout(T *ptr) noexcept
+			{
+				return{ ptr, ptr ? static_cast<int64_t>(*ptr) : 0 };
+			}
+
+			template<class F>
+			inline callback_t<F> callback(F f) noexcept
+			{
+				return{ f };
+			}
+
+			inline opaque_t opaque(void *ptr) noexcept
+			{
+				return{ ptr };
+			}
+
+			template<class T>
+			inline buffer_t<T> buffer(T *ptr, size_t size) noexcept
+			{
+				return{ ptr, size };
+			}
+
+			inline serialized_t serialized(BYTE *ptr, size_t size = 0) noexcept
+			{
+				return{ ptr, size };
+			}
+
+			template<class Char>
+			inline text_t<Char> text(const Char *ptr, size_t length) noexcept
+			{
+				return{ ptr, length };
+			}
+
+			inline text_t<wchar_t> text(const wchar_t *ptr) noexcept
+			{
+				return{ ptr, ptr ? wcslen(ptr) : 0 };
+			}
+
+			inline text8_t text8(const char *ptr, size_t length) noexcept
+			{
+				return{ ptr, length };
+			}
+
+			inline array_t array(JsValueRef *ptr, unsigned short count) noexcept
+			{
+				return{ ptr, count };
+			}
+
+			// trace file writer shared by all threads
+			class recorder
+			{
+				std::mutex lock;
+				FILE *file{ nullptr };
+				std::atomic<bool> active{ false };
+				std::atomic<uint64_t> sequence{ 0 };
+
+			public:
+				static recorder &instance()
+				{
+					static recorder r;
+					return r;
+				}
+
+				~recorder()
+				{
+					stop();
+				}
+
+				bool start(const wchar_t *path)
+				{
+					std::lock_guard<std::mutex> guard{ lock };
+					if (file)
+						return false;
+#if defined(_WIN32)
+					file = _wfopen(path, L"wb");
+#else
+					file = fopen(utf::to_utf8(path, wcslen(path)).c_str(), "wb");
+#endif
+					if (!file)
+						return false;
+					fwrite(&file_magic, sizeof(file_magic), 1, file);
+					fwrite(&file_version, sizeof(file_version), 1, file);
+					sequence = 0;
+					active = true;
+					return true;
+				}
+
+				void stop() noexcept
+				{
+					std::lock_guard<std::mutex> guard{ lock };
+					active = false;
+					if (file)
+					{
+						fclose(file);
+						file = nullptr;
+					}
+				}
+
+				bool is_active() const noexcept
+				{
+					return active.load(std::memory_order_relaxed);
+				}
+
+				uint64_t next_sequence() noexcept
+				{
+					return sequence.fetch_add(1, std::memory_order_relaxed);
+				}
+
+				void write(const std::vector<unsigned char> &record) noexcept
+				{
+					std::lock_guard<std::mutex> guard{ lock };
+					if (file)
+						fwrite(record.data(), 1, record.size(), file);
+				}
+			};
+
+			inline void write_operands(record_writer &) noexcept
+			{}
+
+			template<class Operand, class... Operands>
+			inline void write_operands(record_writer &w, const Operand &operand, const Operands &...operands)
+			{
+				operand.write(w);
+				write_operands(w, operands...);
+			}
+
+			// call ChakraCore function, recording the call if the recorder is active
+			template<class F, class... Operands>
+			inline JsErrorCode invoke(api id, F f, const Operands &...operands)
+			{
+#if defined(CBRIDGE_COUNTERS)
+				counters::count_engine_call();
+#endif
+				auto &r = recorder::instance();
+				if (!r.is_active())
+					return f(operands.arg()...);
+
+				auto sequence = r.next_sequence();
+				auto start = std::chrono::steady_clock::now();
+				auto result = f(operands.arg()...);
+				auto duration = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+
+				static thread_local record_writer w;
+				w.clear();
+				w.put(sequence);
+				w.put(static_cast<uint16_t>(id));
+				w.put(static_cast<uint16_t>(sizeof...(Operands)));
+				w.put(static_cast<uint32_t>(result));
+				w.put(static_cast<uint64_t>(duration));
+				write_operands(w, operands...);
+				r.write(w.bytes());
+				return result;
+			}
+
+			// begin recording engine calls to a file. Returns false if the file cannot be created or recording is already active
+			inline bool start(const wchar_t *path)
+			{
+				return recorder::instance().start(path);
+			}
+
+			// stop recording and close the trace file
+			inline void stop() noexcept
+			{
+				recorder::instance().stop();
+			}
+
+			// Replay
+
+			// per-API totals collected by replay
+			struct api_stats
+			{
+				const char *name;
+				uint64_t calls;
+				uint64_t recorded_errors;	// calls that failed when recorded
+				uint64_t replay_errors;		// calls that failed when replayed
+				uint64_t recorded_ns;
+				uint64_t replayed_ns;
+			};
+
+			struct operand
+			{
+				uint8_t tag;
+				uint64_t handle{ 0 };
+				int64_t integer{ 0 };
+				double number{ 0 };
+				std::u16string text;
+				std::wstring wide;
+				std::string text8;
+				std::vector<JsRef> handles;
+				std::unique_ptr<unsigned char[]> scratch;
+				void *slot{ nullptr };
+			};
+
+			struct record
+			{
+				uint64_t sequence;
+				api id;
+				JsErrorCode error;
+				uint64_t duration;
+				std::vector<operand> operands;
+			};
+
+			class record_reader
+			{
+				FILE *file;
+
+				template<class T>
+				bool get(T &v)
+				{
+					return fread(&v, sizeof(T), 1, file) == 1;
+				}
+
+			public:
+				explicit record_reader(FILE *file) noexcept :
+					file{ file }
+				{}
+
+				bool read(record &r)
+				{
+					uint16_t id, count;
+					uint32_t error;
+					if (!get(r.sequence) || !get(id) || !get(count) || !get(error) || !get(r.duration))
+						return false;
+					r.id = static_cast<api>(id);
+					r.error = static_cast<JsErrorCode>(error);
+					r.operands.resize(count);
+					for (auto &op : r.operands)
+					{
+						if (!get(op.tag))
+							return false;
+						switch (op.tag)
+						{
+						case tag_handle:
+						case tag_out:
+							if (!get(op.handle))
+								return false;
+							break;
+						case tag_integer:
+						case tag_inout:
+							if (!get(op.integer))
+								return false;
+							break;
+						case tag_double:
+							if (!get(op.number))
+								return false;
+							break;
+						case tag_text:
+						{
+							uint32_t length;
+							if (!get(length))
+								return false;
+							op.text.resize(length);
+							if (length && fread(&op.text[0], sizeof(char16_t), length, file) != length)
+								return false;
+							op.wide = utf::to_wstring(op.text.data(), op.text.size());
+							break;
+						}
+						case tag_text8:
+						{
+							uint32_t length;
+							if (!get(length))
+								return false;
+							op.text8.resize(length);
+							if (length && fread(&op.text8[0], 1, length, file) != length)
+								return false;
+							break;
+						}
+						case tag_array:
+						{
+							uint16_t n;
+							if (!get(n))
+								return false;
+							op.handles.resize(n);
+							for (auto &h : op.handles)
+							{
+								uint64_t v;
+								if (!get(v))
+									return false;
+								h = reinterpret_cast<JsRef>(static_cast<uintptr_t>(v));
+							}
+							break;
+						}
+						case tag_scratch:
+						{
+							uint32_t size;
+							if (!get(size))
+								return false;
+							op.integer = size;
+							break;
+						}
+						case tag_buffer:
+							if (!get(op.integer))
+								return false;
+							break;
+						case tag_serialized:
+							if (!get(op.handle) || !get(op.integer))
+								return false;
+							break;
+						case tag_callback:
+						case tag_opaque:
+							break;
+						default:
+							return false;
+						}
+					}
+					return true;
+				}
+			};
+
+			class replayer
+			{
+				// serialized script buffers by recorded address, with the source they were serialized from
+				struct serialized_script
+				{
+					std::wstring script;
+					std::vector<unsigned char> bytes;
+				};
+
+				std::unordered_map<uint64_t, JsRef> handles;
+				std::vector<std::unique_ptr<unsigned char[]>> buffers;
+				std::unordered_map<uint64_t, serialized_script> serialized;
+				std::vector<JsRuntimeHandle> runtimes;
+
+				// replaced native functions do nothing and return undefined
+				static JsValueRef CHAKRA_CALLBACK stub_function(JsValueRef, bool, JsValueRef *, unsigned short, void *)
+				{
+					return JS_INVALID_REFERENCE;
+				}
+
+				JsRef map(uint64_t recorded) const
+				{
+					auto it = handles.find(recorded);
+					return it == handles.end() ? JS_INVALID_REFERENCE : it->second;
+				}
+
+				// argument conversion, selected by parameter type
+				template<class P>
+				std::enable_if_t<std::is_arithmetic<P>::value || std::is_enum<P>::value, P> convert(operand &op)
+				{
+					return op.tag == tag_double ? static_cast<P>(op.number) : static_cast<P>(op.integer);
+				}
+
+				template<class P>
+				std::enable_if_t<std::is_function<std::remove_pointer_t<P>>::value, P> convert(operand &)
+				{
+					return callback_stub(static_cast<P>(nullptr));
+				}
+
+				JsNativeFunction callback_stub(JsNativeFunction) const noexcept
+				{
+					return &stub_function;
+				}
+
+				template<class F>
+				F callback_stub(F) const noexcept
+				{
+					return nullptr;
+				}
+
+				template<class P>
+				std::enable_if_t<std::is_same<P, void *>::value, P> convert(operand &op)
+				{
+					if (op.tag == tag_buffer)
+					{
+						buffers.push_back(std::make_unique<unsigned char[]>(static_cast<size_t>(op.integer)));
+						return buffers.back().get();
+					}
+					return op.tag == tag_handle ? map(op.handle) : nullptr;
+				}
+
+				template<class P>
+				std::enable_if_t<std::is_same<P, const wchar_t *>::value, P> convert(operand &op)
+				{
+					return op.tag == tag_text ? op.wide.c_str() : nullptr;
+				}
+
+				template<class P>
+				std::enable_if_t<std::is_same<P, const uint16_t *>::value, P> convert(operand &op)
+				{
+					return op.tag == tag_text ? reinterpret_cast<const uint16_t *>(op.text.c_str()) : nullptr;
+				}
+
+				template<class P>
+				std::enable_if_t<std::is_same<P, const char *>::value, P> convert(operand &op)
+				{
+					return op.tag == tag_text8 ? op.text8.c_str() : nullptr;
+				}
+
+				template<class T>
+				static std::enable_if_t<std::is_arithmetic<T>::value> initialize(T *p, int64_t v) noexcept
+				{
+					*p = static_cast<T>(v);
+				}
+
+				template<class T>
+				static std::enable_if_t<!std::is_arithmetic<T>::value> initialize(T *, int64_t) noexcept
+				{}
+
+				// output parameters and handle arrays
+				template<class P>
+				std::enable_if_t<std::is_pointer<P>::value && !std::is_function<std::remove_pointer_t<P>>::value &&
+					!std::is_same<P, void *>::value && !std::is_const<std::remove_pointer_t<P>>::value, P> convert(operand &op)
+				{
+					switch (op.tag)
+					{
+					case tag_out:
+						return reinterpret_cast<P>(static_cast<void *>(&op.slot));
+					case tag_array:
+						for (auto &h : op.handles)
+							h = map(static_cast<uint64_t>(reinterpret_cast<uintptr_t>(h)));
+						return reinterpret_cast<P>(static_cast<void *>(op.handles.data()));
+					case tag_scratch:
+						if (!op.integer)
+							return nullptr;
+						op.scratch = std::make_unique<unsigned char[]>(static_cast<size_t>(op.integer) + sizeof(void *));
+						return reinterpret_cast<P>(op.scratch.get());
+					case tag_buffer:
+						if (!op.integer)
+							return nullptr;
+						buffers.push_back(std::make_unique<unsigned char[]>(static_cast<size_t>(op.integer)));
+						return reinterpret_cast<P>(buffers.back().get());
+					case tag_serialized:
+					{
+						if (!op.handle)
+							return nullptr;
+						auto &buffer = serialized[op.handle].bytes;
+						if (op.integer)
+							buffer.resize(static_cast<size_t>(op.integer));
+						return buffer.empty() ? nullptr : reinterpret_cast<P>(buffer.data());
+					}
+					case tag_inout:
+						op.scratch = std::make_unique<unsigned char[]>(sizeof(int64_t));
+						initialize(reinterpret_cast<P>(op.scratch.get()), op.integer);
+						return reinterpret_cast<P>(op.scratch.get());
+					default:
+						return nullptr;
+					}
+				}
+
+				template<class... Params, size_t... I>
+				JsErrorCode call(JsErrorCode(CHAKRA_CALLBACK *f)(Params...), record &r, std::index_sequence<I...>)
+				{
+					r;
+					return f(convert<Params>(r.operands[I])...);
+				}
+
+				template<class... Params>
+				JsErrorCode replay_call(JsErrorCode(CHAKRA_CALLBACK *f)(Params...), record &r)
+				{
+					if (r.operands.size() != sizeof...(Params))
+						return JsErrorInvalidArgument;
+					auto result = call(f, r, std::index_sequence_for<Params...>{});
+					for (auto &op : r.operands)
+						if (op.tag == tag_out && op.handle)
+							handles[op.handle] = op.slot;
+					return result;
+				}
+
+			public:
+				replayer() = default;
+				replayer(const replayer &) = delete;
+				replayer &operator =(const replayer &) = delete;
+
+				~replayer()
+				{
+					JsSetCurrentContext(JS_INVALID_REFERENCE);
+					for (auto runtime : runtimes)
+						JsDisposeRuntime(runtime);
+				}
+
+				// Called before a record is replayed and timed. A serialized script is run from a buffer the replayed
+				// JsSerializeScript call filled. If the trace does not contain that call, for example because the buffer
+				// was loaded from a cache, the buffer is rebuilt from the recorded source
+				void prepare(record &r)
+				{
+					if (r.operands.size() < 2 || r.operands[0].tag != tag_text || r.operands[1].tag != tag_serialized || !r.operands[1].handle)
+						return;
+					auto &entry = serialized[r.operands[1].handle];
+					if (r.id == api::JsSerializeScript)
+						entry.script = r.operands[0].wide;
+					else if (r.id == api::JsRunSerializedScript && (entry.bytes.empty() || entry.script != r.operands[0].wide))
+					{
+						entry.script = r.operands[0].wide;
+						unsigned int size = 0;
+						if (::JsSerializeScript(entry.script.c_str(), nullptr, &size) == JsNoError)
+						{
+							entry.bytes.resize(size);
+							if (::JsSerializeScript(entry.script.c_str(), entry.bytes.data(), &size) != JsNoError)
+								entry.bytes.clear();
+						}
+					}
+				}
+
+				JsErrorCode replay(record &r)
+				{
+					JsErrorCode result;
+					switch (r.id)
+					{
+#define CBRIDGE_TRACE_REPLAY(name) case api::name: result = replay_call(&::name, r); break;
+						CBRIDGE_TRACE_APIS(CBRIDGE_TRACE_REPLAY)
+#undef CBRIDGE_TRACE_REPLAY
+					default:
+						return JsErrorInvalidArgument;
+					}
+
+					// track runtimes so that those not disposed in the trace are disposed at the end
+					if (r.id == api::JsCreateRuntime && result == JsNoError)
+						runtimes.push_back(r.operands.back().slot);
+					else if (r.id == api::JsDisposeRuntime && result == JsNoError)
+						runtimes.erase(std::remove(runtimes.begin(), runtimes.end(), map(r.operands.front().handle)), runtimes.end());
+					return result;
+				}
+			};
+
+			// replay a trace file against a local runtime and return per-API statistics.
+			// Native functions are replaced with functions returning undefined, handles the trace did not create are passed as null
+			inline std::vector<api_stats> replay(const wchar_t *path)
+			{
+#if defined(_WIN32)
+				std::unique_ptr<FILE, int(*)(FILE *)> file{ _wfopen(path, L"rb"), &fclose };
+#else
+				std::unique_ptr<FILE, int(*)(FILE *)> file{ fopen(utf::to_utf8(path, wcslen(path)).c_str(), "rb"), &fclose };
+#endif
+				if (!file)
+					return{};
+
+				uint32_t magic, version;
+				if (fread(&magic, sizeof(magic), 1, file.get()) != 1 || magic != file_magic ||
+					fread(&version, sizeof(version), 1, file.get()) != 1 || version != file_version)
+					return{};
+
+				// records are written when calls complete; replay them in the order the calls were made
+				std::vector<record> records;
+				record_reader reader{ file.get() };
+				for (record r; reader.read(r);)
+					records.push_back(std::move(r));
+				std::sort(records.begin(), records.end(), [](const record &a, const record &b) { return a.sequence < b.sequence; });
+
+				std::vector<api_stats> stats(static_cast<size_t>(api::count));
+				for (size_t i = 0; i < stats.size(); ++i)
+					stats[i] = { api_name(static_cast<api>(i)), 0, 0, 0, 0, 0 };
+
+				replayer player;
+				for (auto &r : records)
+				{
+					if (r.id >= api::count)
+						continue;
+					player.prepare(r);
+					auto start = std::chrono::steady_clock::now();
+					auto result = player.replay(r);
+					auto duration = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+
+					auto &s = stats[static_cast<size_t>(r.id)];
+					++s.calls;
+					s.recorded_ns += r.duration;
+					s.replayed_ns += static_cast<uint64_t>(duration);
+					if (r.error != JsNoError)
+						++s.recorded_errors;
+					if (result != JsNoError)
+						++s.replay_errors;
+				}
+
+				stats.erase(std::remove_if(stats.begin(), stats.end(), [](const api_stats &s) { return s.calls == 0; }), stats.end());
+				std::sort(stats.begin(), stats.end(), [](const api_stats &a, const api_stats &b) { return a.replayed_ns > b.replayed_ns; });
+				return stats;
+			}
+		}
+
+#if defined(CBRIDGE_TRACE) || defined(CBRIDGE_COUNTERS)
+		// Shims for every ChakraCore function called by the library. Same-named declarations would be ambiguous with
+		// the global ones when arguments bring the global namespace into argument-dependent lookup, so calls are
+		// redirected to jsc::details::shim with macros defined below
+		namespace shim
+		{
+#define CBRIDGE_TRACE_SHIM(name, params, ...) \
+			inline JsErrorCode name params \
+			{ \
+				return trace::invoke(trace::api::name, &::name, __VA_ARGS__); \
+			} \
+// end of macro
+
+			// runtime and context
+			CBRIDGE_TRACE_SHIM(JsCreateRuntime, (JsRuntimeAttributes attributes, JsThreadServiceCallback threadService, JsRuntimeHandle *runtime), trace::scalar(attributes), trace::callback(threadService), trace::out(runtime))
+			CBRIDGE_TRACE_SHIM(JsDisposeRuntime, (JsRuntimeHandle runtime), trace::in(runtime))
+			CBRIDGE_TRACE_SHIM(JsCreateContext, (JsRuntimeHandle runtime, JsContextRef *newContext), trace::in(runtime), trace::out(newContext))
+			CBRIDGE_TRACE_SHIM(JsGetCurrentContext, (JsContextRef *currentContext), trace::out(currentContext))
+			CBRIDGE_TRACE_SHIM(JsSetCurrentContext, (JsContextRef context), trace::in(context))
+			CBRIDGE_TRACE_SHIM(JsGetRuntime, (JsContextRef context, JsRuntimeHandle *runtime), trace::in(context), trace::out(runtime))
+			CBRIDGE_TRACE_SHIM(JsGetContextData, (JsContextRef context, void **data), trace::in(context), trace::scratch(data))
+			CBRIDGE_TRACE_SHIM(JsSetContextData, (JsContextRef context, void *data), trace::in(context), trace::opaque(data))
+
+			// references
+			CBRIDGE_TRACE_SHIM(JsAddRef, (JsRef ref, unsigned int *count), trace::in(ref), trace::scratch(count))
+			CBRIDGE_TRACE_SHIM(JsRelease, (JsRef ref, unsigned int *count), trace::in(ref), trace::scratch(count))
+			CBRIDGE_TRACE_SHIM(JsSetObjectBeforeCollectCallback, (JsRef ref, void *callbackState, JsObjectBeforeCollectCallback objectBeforeCollectCallback), trace::in(ref), trace::opaque(callbackState), trace::callback(objectBeforeCollectCallback))
+
+			// values
+			CBRIDGE_TRACE_SHIM(JsGetUndefinedValue, (JsValueRef *undefinedValue), trace::out(undefinedValue))
+			CBRIDGE_TRACE_SHIM(JsGetNullValue, (JsValueRef *nullValue), trace::out(nullValue))
+			CBRIDGE_TRACE_SHIM(JsGetTrueValue, (JsValueRef *trueValue), trace::out(trueValue))
+			CBRIDGE_TRACE_SHIM(JsGetFalseValue, (JsValueRef *falseValue), trace::out(falseValue))
+			CBRIDGE_TRACE_SHIM(JsBoolToBoolean, (bool value, JsValueRef *booleanValue), trace::scalar(value), trace::out(booleanValue))
+			CBRIDGE_TRACE_SHIM(JsBooleanToBool, (JsValueRef value, bool *boolValue), trace::in(value), trace::scratch(boolValue))
+			CBRIDGE_TRACE_SHIM(JsDoubleToNumber, (double doubleValue, JsValueRef *value), trace::scalar(doubleValue), trace::out(value))
+			CBRIDGE_TRACE_SHIM(JsIntToNumber, (int intValue, JsValueRef *value), trace::scalar(intValue), trace::out(value))
+			CBRIDGE_TRACE_SHIM(JsNumberToDouble, (JsValueRef value, double *doubleValue), trace::in(value), trace::scratch(doubleValue))
+			CBRIDGE_TRACE_SHIM(JsNumberToInt, (JsValueRef value, int *intValue), trace::in(value), trace::scratch(intValue))
+			CBRIDGE_TRACE_SHIM(JsConvertValueToNumber, (JsValueRef value, JsValueRef *numberValue), trace::in(value), trace::out(numberValue))
+			CBRIDGE_TRACE_SHIM(JsConvertValueToString, (JsValueRef value, JsValueRef *stringValue), trace::in(value), trace::out(stringValue))
+			CBRIDGE_TRACE_SHIM(JsConvertValueToObject, (JsValueRef value, JsValueRef *object), trace::in(value), trace::out(object))
+			CBRIDGE_TRACE_SHIM(JsGetValueType, (JsValueRef value, JsValueType *type), trace::in(value), trace::scratch(type))
+
+			// objects
+			CBRIDGE_TRACE_SHIM(JsGetPrototype, (JsValueRef object, JsValueRef *prototypeObject), trace::in(object), trace::out(prototypeObject))
+			CBRIDGE_TRACE_SHIM(JsGetGlobalObject, (JsValueRef *globalObject), trace::out(globalObject))
+			CBRIDGE_TRACE_SHIM(JsCreateObject, (JsValueRef *object), trace::out(object))
+			CBRIDGE_TRACE_SHIM(JsCreateExternalObject, (void *data, JsFinalizeCallback finalizeCallback, JsValueRef *object), trace::opaque(data), trace::callback(finalizeCallback), trace::out(object))
+			CBRIDGE_TRACE_SHIM(JsGetExternalData, (JsValueRef object, void **externalData), trace::in(object), trace::scratch(externalData))
+			CBRIDGE_TRACE_SHIM(JsGetProperty, (JsValueRef object, JsPropertyIdRef propertyId, JsValueRef *value), trace::in(object), trace::in(propertyId), trace::out(value))
+			CBRIDGE_TRACE_SHIM(JsSetProperty, (JsValueRef object, JsPropertyIdRef propertyId, JsValueRef value, bool useStrictRules), trace::in(object), trace::in(propertyId), trace::in(value), trace::scalar(useStrictRules))
+			CBRIDGE_TRACE_SHIM(JsDefineProperty, (JsValueRef object, JsPropertyIdRef propertyId, JsValueRef propertyDescriptor, bool *result), trace::in(object), trace::in(propertyId), trace::in(propertyDescriptor), trace::scratch(result))
+			CBRIDGE_TRACE_SHIM(JsGetIndexedProperty, (JsValueRef object, JsValueRef index, JsValueRef *result), trace::in(object), trace::in(index), trace::out(result))
+			CBRIDGE_TRACE_SHIM(JsSetIndexedProperty, (JsValueRef object, JsValueRef index, JsValueRef value), trace::in(object), trace::in(index), trace::in(value))
+
+			// arrays
+			CBRIDGE_TRACE_SHIM(JsCreateArray, (unsigned int length, JsValueRef *result), trace::scalar(length), trace::out(result))
+			CBRIDGE_TRACE_SHIM(JsCreateExternalArrayBuffer, (void *data, unsigned int byteLength, JsFinalizeCallback finalizeCallback, void *callbackState, JsValueRef *result), trace::buffer(data, byteLength), trace::scalar(byteLength), trace::callback(finalizeCallback), trace::opaque(callbackState), trace::out(result))
+			CBRIDGE_TRACE_SHIM(JsCreateTypedArray, (JsTypedArrayType arrayType, JsValueRef baseArray, unsigned int byteOffset, unsigned int elementLength, JsValueRef *result), trace::scalar(arrayType), trace::in(baseArray), trace::scalar(byteOffset), trace::scalar(elementLength), trace::out(result))
+			CBRIDGE_TRACE_SHIM(JsGetTypedArrayInfo, (JsValueRef typedArray, JsTypedArrayType *arrayType, JsValueRef *arrayBuffer, unsigned int *byteOffset, unsigned int *byteLength), trace::in(typedArray), trace::scratch(arrayType), trace::out(arrayBuffer), trace::scratch(byteOffset), trace::scratch(byteLength))
+			CBRIDGE_TRACE_SHIM(JsGetTypedArrayStorage, (JsValueRef typedArray, ChakraBytePtr *buffer, unsigned int *bufferLength, JsTypedArrayType *arrayType, int *elementSize), trace::in(typedArray), trace::scratch(buffer), trace::scratch(bufferLength), trace::scratch(arrayType), trace::scratch(elementSize))
+
+			// functions
+			CBRIDGE_TRACE_SHIM(JsCreateFunction, (JsNativeFunction nativeFunction, void *callbackState, JsValueRef *function), trace::callback(nativeFunction), trace::opaque(callbackState), trace::out(function))
+			CBRIDGE_TRACE_SHIM(JsCallFunction, (JsValueRef function, JsValueRef *arguments, unsigned short argumentCount, JsValueRef *result), trace::in(function), trace::array(arguments, argumentCount), trace::scalar(argumentCount), trace::out(result))
+
+			// errors
+			CBRIDGE_TRACE_SHIM(JsCreateError, (JsValueRef message, JsValueRef *error), trace::in(message), trace::out(error))
+			CBRIDGE_TRACE_SHIM(JsCreateRangeError, (JsValueRef message, JsValueRef *error), trace::in(message), trace::out(error))
+			CBRIDGE_TRACE_SHIM(JsHasException, (bool *hasException), trace::scratch(hasException))
+			CBRIDGE_TRACE_SHIM(JsGetAndClearException, (JsValueRef *exception), trace::out(exception))
+			CBRIDGE_TRACE_SHIM(JsSetException, (JsValueRef exception), trace::in(exception))
+
+			// scripts
+			CBRIDGE_TRACE_SHIM(JsRunScript, (const wchar_t *script, JsSourceContext sourceContext, const wchar_t *sourceUrl, JsValueRef *result), trace::text(script), trace::scalar(sourceContext), trace::text(sourceUrl), trace::out(result))
+			CBRIDGE_TRACE_SHIM(JsParseScript, (const wchar_t *script, JsSourceContext sourceContext, const wchar_t *sourceUrl, JsValueRef *result), trace::text(script), trace::scalar(sourceContext), trace::text(sourceUrl), trace::out(result))
+			CBRIDGE_TRACE_SHIM(JsParseScriptWithAttributes, (const wchar_t *script, JsSourceContext sourceContext, const wchar_t *sourceUrl, JsParseScriptAttributes parseAttributes, JsValueRef *result), trace::text(script), trace::scalar(sourceContext), trace::text(sourceUrl), trace::scalar(parseAttributes), trace::out(result))
+			CBRIDGE_TRACE_SHIM(JsExperimentalApiRunModule, (const wchar_t *script, JsSourceContext sourceContext, const wchar_t *sourceUrl, JsValueRef *result), trace::text(script), trace::scalar(sourceContext), trace::text(sourceUrl), trace::out(result))
+
+			// strings
+#if defined(CBRIDGE_WCHAR_UTF16)
+			CBRIDGE_TRACE_SHIM(JsPointerToString, (const wchar_t *stringValue, size_t stringLength, JsValueRef *value), trace::text(stringValue, stringLength), trace::scalar(stringLength), trace::out(value))
+			CBRIDGE_TRACE_SHIM(JsStringToPointer, (JsValueRef value, const wchar_t **stringValue, size_t *stringLength), trace::in(value), trace::scratch(stringValue), trace::scratch(stringLength))
+			CBRIDGE_TRACE_SHIM(JsGetPropertyIdFromName, (const wchar_t *name, JsPropertyIdRef *propertyId), trace::text(name), trace::out(propertyId))
+#else
+			CBRIDGE_TRACE_SHIM(JsCreateStringUtf16, (const uint16_t *content, size_t length, JsValueRef *value), trace::text(content, length), trace::scalar(length), trace::out(value))
+			CBRIDGE_TRACE_SHIM(JsCopyStringUtf16, (JsValueRef value, int start, int length, uint16_t *buffer, size_t *written), trace::in(value), trace::scalar(start), trace::scalar(length), trace::scratch(buffer, length * sizeof(uint16_t)), trace::scratch(written))
+			CBRIDGE_TRACE_SHIM(JsGetStringLength, (JsValueRef value, int *length), trace::in(value), trace::scratch(length))
+			CBRIDGE_TRACE_SHIM(JsCreatePropertyId, (const char *name, size_t length, JsPropertyIdRef *propertyId), trace::text8(name, length), trace::scalar(length), trace::out(propertyId))
+#endif
+
+			// serialized scripts
+			CBRIDGE_TRACE_SHIM(JsSerializeScript, (const wchar_t *script, BYTE *buffer, unsigned int *bufferSize), trace::text(script), trace::serialized(buffer, buffer && bufferSize ? *bufferSize : 0), trace::inout(bufferSize))
+			CBRIDGE_TRACE_SHIM(JsRunSerializedScript, (const wchar_t *script, BYTE *buffer, JsSourceContext sourceContext, const wchar_t *sourceUrl, JsValueRef *result), trace::text(script), trace::serialized(buffer), trace::scalar(sourceContext), trace::text(sourceUrl), trace::out(result))
+			CBRIDGE_TRACE_SHIM(JsGetPropertyIdFromSymbol, (JsValueRef symbol, JsPropertyIdRef *propertyId), trace::in(symbol), trace::out(propertyId))
+			CBRIDGE_TRACE_SHIM(JsConvertValueToBoolean, (JsValueRef value, JsValueRef *booleanValue), trace::in(value), trace::out(booleanValue))
+			CBRIDGE_TRACE_SHIM(JsConstructObject, (JsValueRef function, JsValueRef *arguments, unsigned short argumentCount, JsValueRef *result), trace::in(function), trace::array(arguments, argumentCount), trace::scalar(argumentCount), trace::out(result))
+			CBRIDGE_TRACE_SHIM(JsCreateSymbol, (JsValueRef description, JsValueRef *result), trace::in(description), trace::out(result))
+
+#undef CBRIDGE_TRACE_SHIM
+		}
+#endif
+	}
+
+	namespace trace
+	{
+		using details::trace::start;
+		using details::trace::stop;
+		using details::trace::replay;
+		using details::trace::api_stats;
+	}
+
+	namespace counters
+	{
+		using details::counters::operation_counters;
+		using details::counters::snapshot;
+		using details::counters::reset;
+	}
+}
+
+#if defined(CBRIDGE_TRACE) || defined(CBRIDGE_COUNTERS)
+// Redirect calls made after this point to the shims. The macros are object-like and expand to a relative name, so
+// calls qualified as ::JsRunScript(...) and function pointers such as &JsRelease are redirected as well
+#define JsCreateRuntime jsc::details::shim::JsCreateRuntime
+#define JsDisposeRuntime jsc::details::shim::JsDisposeRuntime
+#define JsCreateContext jsc::details::shim::JsCreateContext
+#define JsGetCurrentContext jsc::details::shim::JsGetCurrentContext
+#define JsSetCurrentContext jsc::details::shim::JsSetCurrentContext
+#define JsGetRuntime jsc::details::shim::JsGetRuntime
+#define JsGetContextData jsc::details::shim::JsGetContextData
+#define JsSetContextData jsc::details::shim::JsSetContextData
+#define JsAddRef jsc::details::shim::JsAddRef
+#define JsRelease jsc::details::shim::JsRelease
+#define JsSetObjectBeforeCollectCallback jsc::details::shim::JsSetObjectBeforeCollectCallback
+#define JsGetUndefinedValue jsc::details::shim::JsGetUndefinedValue
+#define JsGetNullValue jsc::details::shim::JsGetNullValue
+#define JsGetTrueValue jsc::details::shim::JsGetTrueValue
+#define JsGetFalseValue jsc::details::shim::JsGetFalseValue
+#define JsBoolToBoolean jsc::details::shim::JsBoolToBoolean
+#define JsBooleanToBool jsc::details::shim::JsBooleanToBool
+#define JsDoubleToNumber jsc::details::shim::JsDoubleToNumber
+#define JsIntToNumber jsc::details::shim::JsIntToNumber
+#define JsNumberToDouble jsc::details::shim::JsNumberToDouble
+#define JsNumberToInt jsc::details::shim::JsNumberToInt
+#define JsConvertValueToNumber jsc::details::shim::JsConvertValueToNumber
+#define JsConvertValueToString jsc::details::shim::JsConvertValueToString
+#define JsConvertValueToObject jsc::details::shim::JsConvertValueToObject
+#define JsGetValueType jsc::details::shim::JsGetValueType
+#define JsGetPrototype jsc::details::shim::JsGetPrototype
+#define JsGetGlobalObject jsc::details::shim::JsGetGlobalObject
+#define JsCreateObject jsc::details::shim::JsCreateObject
+#define JsCreateExternalObject jsc::details::shim::JsCreateExternalObject
+#define JsGetExternalData jsc::details::shim::JsGetExternalData
+#define JsGetProperty jsc::details::shim::JsGetProperty
+#define JsSetProperty jsc::details::shim::JsSetProperty
+#define JsDefineProperty jsc::details::shim::JsDefineProperty
+#define JsGetIndexedProperty jsc::details::shim::JsGetIndexedProperty
+#define JsSetIndexedProperty jsc::details::shim::JsSetIndexedProperty
+#define JsCreateArray jsc::details::shim::JsCreateArray
+#define JsCreateExternalArrayBuffer jsc::details::shim::JsCreateExternalArrayBuffer
+#define JsCreateTypedArray jsc::details::shim::JsCreateTypedArray
+#define JsGetTypedArrayInfo jsc::details::shim::JsGetTypedArrayInfo
+#define JsGetTypedArrayStorage jsc::details::shim::JsGetTypedArrayStorage
+#define JsCreateFunction jsc::details::shim::JsCreateFunction
+#define JsCallFunction jsc::details::shim::JsCallFunction
+#define JsCreateError jsc::details::shim::JsCreateError
+#define JsCreateRangeError jsc::details::shim::JsCreateRangeError
+#define JsHasException jsc::details::shim::JsHasException
+#define JsGetAndClearException jsc::details::shim::JsGetAndClearException
+#define JsSetException jsc::details::shim::JsSetException
+#define JsRunScript jsc::details::shim::JsRunScript
+#define JsParseScript jsc::details::shim::JsParseScript
+#define JsParseScriptWithAttributes jsc::details::shim::JsParseScriptWithAttributes
+#define JsExperimentalApiRunModule jsc::details::shim::JsExperimentalApiRunModule
+#if defined(CBRIDGE_WCHAR_UTF16)
+#define JsPointerToString jsc::details::shim::JsPointerToString
+#define JsStringToPointer jsc::details::shim::JsStringToPointer
+#define JsGetPropertyIdFromName jsc::details::shim::JsGetPropertyIdFromName
+#else
+#define JsCreateStringUtf16 jsc::details::shim::JsCreateStringUtf16
+#define JsCopyStringUtf16 jsc::details::shim::JsCopyStringUtf16
+#define JsGetStringLength jsc::details::shim::JsGetStringLength
+#define JsCreatePropertyId jsc::details::shim::JsCreatePropertyId
+#endif
+#define JsSerializeScript jsc::details::shim::JsSerializeScript
+#define JsRunSerializedScript jsc::details::shim::JsRunSerializedScript
+#define JsGetPropertyIdFromSymbol jsc::details::shim::JsGetPropertyIdFromSymbol
+#define JsConvertValueToBoolean jsc::details::shim::JsConvertValueToBoolean
+#define JsConstructObject jsc::details::shim::JsConstructObject
+#define JsCreateSymbol jsc::details::shim::JsCreateSymbol
+#endif
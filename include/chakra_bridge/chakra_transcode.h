@@ -0,0 +1,563 @@
+//-------------------------------------------------------------------------------------------------------
+// Copyright (C) 2016 HHD Software Ltd.
+// Written by Alexander Bessonov
+//
+// Licensed under the MIT license. See LICENSE.txt file in the project root for full license information.
+//-------------------------------------------------------------------------------------------------------
+
+#pragma once
+
+// STL
+#include <string>
+#include <memory>
+#include <cstddef>
+#include <cstdint>
+#include <cwchar>
+
+// Instruction set selection. Define CBRIDGE_NO_SIMD to force scalar code
+#if !defined(CBRIDGE_NO_SIMD)
+#if defined(__AVX2__)
+#define CBRIDGE_TRANSCODE_AVX2
+#endif
+#if defined(__SSE4_1__) || defined(__AVX__)
+#define CBRIDGE_TRANSCODE_SSE4
+#endif
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define CBRIDGE_TRANSCODE_SSE2
+#endif
+#endif
+
+#if defined(CBRIDGE_TRANSCODE_AVX2)
+#include <immintrin.h>
+#elif defined(CBRIDGE_TRANSCODE_SSE4)
+#include <smmintrin.h>
+#elif defined(CBRIDGE_TRANSCODE_SSE2)
+#include <emmintrin.h>
+#endif
+
+// ChakraCore strings are UTF-16. wchar_t is UTF-16 on Windows and UTF-32 elsewhere
+#if WCHAR_MAX <= 0xFFFF
+#define CBRIDGE_WCHAR_UTF16
+#endif
+
+namespace jsc
+{
+	namespace details
+	{
+		// Conversion between UTF-8, UTF-16 and UTF-32.
+		// All functions write to a caller-provided buffer and return the number of code units written.
+		// Ill-formed input sequences are replaced with U+FFFD
+		namespace utf
+		{
+			const char32_t replacement_character = 0xFFFD;
+
+			// scalar helpers
+			inline bool is_high_surrogate(char32_t c) noexcept
+			{
+				return c >= 0xD800 && c <= 0xDBFF;
+			}
+
+			inline bool is_low_surrogate(char32_t c) noexcept
+			{
+				return c >= 0xDC00 && c <= 0xDFFF;
+			}
+
+			// decode a single code point, advancing src. src < end
+			inline char32_t decode_utf8(const unsigned char *&src, const unsigned char *end) noexcept
+			{
+				auto lead = *src++;
+				if (lead < 0x80)
+					return lead;
+
+				int count;
+				char32_t cp, min;
+				if (lead >= 0xC2 && lead <= 0xDF)
+				{
+					count = 1;
+					cp = lead & 0x1F;
+					min = 0x80;
+				}
+				else if (lead >= 0xE0 && lead <= 0xEF)
+				{
+					count = 2;
+					cp = lead & 0x0F;
+					min = 0x800;
+				}
+				else if (lead >= 0xF0 && lead <= 0xF4)
+				{
+					count = 3;
+					cp = lead & 0x07;
+					min = 0x10000;
+				}
+				else
+					return replacement_character;
+
+				auto p = src;
+				for (int i = 0; i < count; ++i, ++p)
+				{
+					if (p == end || (*p & 0xC0) != 0x80)
+					{
+						src = p;
+						return replacement_character;
+					}
+					cp = (cp << 6) | (*p & 0x3F);
+				}
+				src = p;
+				if (cp < min || cp > 0x10FFFF || (cp >= 0xD800 && cp <= 0xDFFF))
+					return replacement_character;
+				return cp;
+			}
+
+			// decode a single code point, advancing src. src < end
+			inline char32_t decode_utf16(const char16_t *&src, const char16_t *end) noexcept
+			{
+				char32_t c = *src++;
+				if (is_high_surrogate(c))
+				{
+					if (src != end && is_low_surrogate(*src))
+						return 0x10000 + ((c - 0xD800) << 10) + (*src++ - 0xDC00);
+					return replacement_character;
+				}
+				return is_low_surrogate(c) ? replacement_character : c;
+			}
+
+			inline char32_t validate_utf32(char32_t c) noexcept
+			{
+				return c > 0x10FFFF || (c >= 0xD800 && c <= 0xDFFF) ? replacement_character : c;
+			}
+
+			inline char *encode_utf8(char32_t c, char *dst) noexcept
+			{
+				if (c < 0x80)
+					*dst++ = static_cast<char>(c);
+				else if (c < 0x800)
+				{
+					*dst++ = static_cast<char>(0xC0 | (c >> 6));
+					*dst++ = static_cast<char>(0x80 | (c & 0x3F));
+				}
+				else if (c < 0x10000)
+				{
+					*dst++ = static_cast<char>(0xE0 | (c >> 12));
+					*dst++ = static_cast<char>(0x80 | ((c >> 6) & 0x3F));
+					*dst++ = static_cast<char>(0x80 | (c & 0x3F));
+				}
+				else
+				{
+					*dst++ = static_cast<char>(0xF0 | (c >> 18));
+					*dst++ = static_cast<char>(0x80 | ((c >> 12) & 0x3F));
+					*dst++ = static_cast<char>(0x80 | ((c >> 6) & 0x3F));
+					*dst++ = static_cast<char>(0x80 | (c & 0x3F));
+				}
+				return dst;
+			}
+
+			inline char16_t *encode_utf16(char32_t c, char16_t *dst) noexcept
+			{
+				if (c < 0x10000)
+					*dst++ = static_cast<char16_t>(c);
+				else
+				{
+					c -= 0x10000;
+					*dst++ = static_cast<char16_t>(0xD800 + (c >> 10));
+					*dst++ = static_cast<char16_t>(0xDC00 + (c & 0x3FF));
+				}
+				return dst;
+			}
+
+			// Vectorized fast paths. Each function converts as many leading code units as it can
+			// (whole blocks of ASCII or non-surrogate BMP characters) and advances the pointers
+			inline void ascii_utf8_to_utf16(const unsigned char *&src, const unsigned char *end, char16_t *&dst) noexcept
+			{
+#if defined(CBRIDGE_TRANSCODE_AVX2)
+				for (; end - src >= 32; src += 32, dst += 32)
+				{
+					auto in = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(src));
+					if (_mm256_movemask_epi8(in))
+						break;
+					_mm256_storeu_si256(reinterpret_cast<__m256i *>(dst), _mm256_cvtepu8_epi16(_mm256_castsi256_si128(in)));
+					_mm256_storeu_si256(reinterpret_cast<__m256i *>(dst + 16), _mm256_cvtepu8_epi16(_mm256_extracti128_si256(in, 1)));
+				}
+#endif
+#if defined(CBRIDGE_TRANSCODE_SSE2)
+				auto zero = _mm_setzero_si128();
+				for (; end - src >= 16; src += 16, dst += 16)
+				{
+					auto in = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src));
+					if (_mm_movemask_epi8(in))
+						break;
+					_mm_storeu_si128(reinterpret_cast<__m128i *>(dst), _mm_unpacklo_epi8(in, zero));
+					_mm_storeu_si128(reinterpret_cast<__m128i *>(dst + 8), _mm_unpackhi_epi8(in, zero));
+				}
+#else
+				src;
+				end;
+				dst;
+#endif
+			}
+
+			inline void ascii_utf8_to_utf32(const unsigned char *&src, const unsigned char *end, char32_t *&dst) noexcept
+			{
+#if defined(CBRIDGE_TRANSCODE_SSE2)
+				auto zero = _mm_setzero_si128();
+				for (; end - src >= 16; src += 16, dst += 16)
+				{
+					auto in = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src));
+					if (_mm_movemask_epi8(in))
+						break;
+					auto lo = _mm_unpacklo_epi8(in, zero);
+					auto hi = _mm_unpackhi_epi8(in, zero);
+					_mm_storeu_si128(reinterpret_cast<__m128i *>(dst), _mm_unpacklo_epi16(lo, zero));
+					_mm_storeu_si128(reinterpret_cast<__m128i *>(dst + 4), _mm_unpackhi_epi16(lo, zero));
+					_mm_storeu_si128(reinterpret_cast<__m128i *>(dst + 8), _mm_unpacklo_epi16(hi, zero));
+					_mm_storeu_si128(reinterpret_cast<__m128i *>(dst + 12), _mm_unpackhi_epi16(hi, zero));
+				}
+#else
+				src;
+				end;
+				dst;
+#endif
+			}
+
+			inline void ascii_utf16_to_utf8(const char16_t *&src, const char16_t *end, char *&dst) noexcept
+			{
+#if defined(CBRIDGE_TRANSCODE_AVX2)
+				auto mask256 = _mm256_set1_epi16(static_cast<short>(0xFF80));
+				for (; end - src >= 32; src += 32, dst += 32)
+				{
+					auto a = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(src));
+					auto b = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(src + 16));
+					if (!_mm256_testz_si256(_mm256_or_si256(a, b), mask256))
+						break;
+					// packus works within 128-bit lanes, restore element order afterwards
+					auto packed = _mm256_permute4x64_epi64(_mm256_packus_epi16(a, b), 0xD8);
+					_mm256_storeu_si256(reinterpret_cast<__m256i *>(dst), packed);
+				}
+#endif
+#if defined(CBRIDGE_TRANSCODE_SSE2)
+				auto mask = _mm_set1_epi16(static_cast<short>(0xFF80));
+				auto zero = _mm_setzero_si128();
+				for (; end - src >= 16; src += 16, dst += 16)
+				{
+					auto a = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src));
+					auto b = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + 8));
+					if (_mm_movemask_epi8(_mm_cmpeq_epi16(_mm_and_si128(_mm_or_si128(a, b), mask), zero)) != 0xFFFF)
+						break;
+					_mm_storeu_si128(reinterpret_cast<__m128i *>(dst), _mm_packus_epi16(a, b));
+				}
+#else
+				src;
+				end;
+				dst;
+#endif
+			}
+
+			inline void ascii_utf32_to_utf8(const char32_t *&src, const char32_t *end, char *&dst) noexcept
+			{
+#if defined(CBRIDGE_TRANSCODE_SSE2)
+				auto mask = _mm_set1_epi32(static_cast<int>(0xFFFFFF80));
+				auto zero = _mm_setzero_si128();
+				for (; end - src >= 16; src += 16, dst += 16)
+				{
+					auto a = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src));
+					auto b = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + 4));
+					auto c = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + 8));
+					auto d = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + 12));
+					auto any = _mm_or_si128(_mm_or_si128(a, b), _mm_or_si128(c, d));
+					if (_mm_movemask_epi8(_mm_cmpeq_epi32(_mm_and_si128(any, mask), zero)) != 0xFFFF)
+						break;
+					_mm_storeu_si128(reinterpret_cast<__m128i *>(dst), _mm_packus_epi16(_mm_packs_epi32(a, b), _mm_packs_epi32(c, d)));
+				}
+#else
+				src;
+				end;
+				dst;
+#endif
+			}
+
+			inline void bmp_utf16_to_utf32(const char16_t *&src, const char16_t *end, char32_t *&dst) noexcept
+			{
+#if defined(CBRIDGE_TRANSCODE_AVX2)
+				auto surrogate_mask256 = _mm256_set1_epi16(static_cast<short>(0xF800));
+				auto surrogate256 = _mm256_set1_epi16(static_cast<short>(0xD800));
+				for (; end - src >= 16; src += 16, dst += 16)
+				{
+					auto in = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(src));
+					if (_mm256_movemask_epi8(_mm256_cmpeq_epi16(_mm256_and_si256(in, surrogate_mask256), surrogate256)))
+						break;
+					_mm256_storeu_si256(reinterpret_cast<__m256i *>(dst), _mm256_cvtepu16_epi32(_mm256_castsi256_si128(in)));
+					_mm256_storeu_si256(reinterpret_cast<__m256i *>(dst + 8), _mm256_cvtepu16_epi32(_mm256_extracti128_si256(in, 1)));
+				}
+#endif
+#if defined(CBRIDGE_TRANSCODE_SSE2)
+				auto surrogate_mask = _mm_set1_epi16(static_cast<short>(0xF800));
+				auto surrogate = _mm_set1_epi16(static_cast<short>(0xD800));
+				auto zero = _mm_setzero_si128();
+				for (; end - src >= 8; src += 8, dst += 8)
+				{
+					auto in = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src));
+					if (_mm_movemask_epi8(_mm_cmpeq_epi16(_mm_and_si128(in, surrogate_mask), surrogate)))
+						break;
+					_mm_storeu_si128(reinterpret_cast<__m128i *>(dst), _mm_unpacklo_epi16(in, zero));
+					_mm_storeu_si128(reinterpret_cast<__m128i *>(dst + 4), _mm_unpackhi_epi16(in, zero));
+				}
+#else
+				src;
+				end;
+				dst;
+#endif
+			}
+
+			inline void bmp_utf32_to_utf16(const char32_t *&src, const char32_t *end, char16_t *&dst) noexcept
+			{
+#if defined(CBRIDGE_TRANSCODE_SSE2)
+				auto surrogate_mask = _mm_set1_epi32(static_cast<int>(0xFFFFF800));
+				auto surrogate = _mm_set1_epi32(0xD800);
+				auto zero = _mm_setzero_si128();
+				for (; end - src >= 8; src += 8, dst += 8)
+				{
+					auto a = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src));
+					auto b = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + 4));
+					// reject code points above U+FFFF and surrogates
+					auto above_bmp = _mm_or_si128(_mm_srli_epi32(a, 16), _mm_srli_epi32(b, 16));
+					auto surrogates = _mm_or_si128(
+						_mm_cmpeq_epi32(_mm_and_si128(a, surrogate_mask), surrogate),
+						_mm_cmpeq_epi32(_mm_and_si128(b, surrogate_mask), surrogate));
+					if (_mm_movemask_epi8(_mm_cmpeq_epi32(above_bmp, zero)) != 0xFFFF || _mm_movemask_epi8(surrogates))
+						break;
+#if defined(CBRIDGE_TRANSCODE_SSE4)
+					auto packed = _mm_packus_epi32(a, b);
+#else
+					// bias into signed 16-bit range, pack with signed saturation and remove the bias
+					auto bias32 = _mm_set1_epi32(0x8000);
+					auto packed = _mm_add_epi16(_mm_packs_epi32(_mm_sub_epi32(a, bias32), _mm_sub_epi32(b, bias32)), _mm_set1_epi16(static_cast<short>(0x8000)));
+#endif
+					_mm_storeu_si128(reinterpret_cast<__m128i *>(dst), packed);
+				}
+#else
+				src;
+				end;
+				dst;
+#endif
+			}
+
+			// conversion functions
+
+			// dst must have room for length code units
+			inline size_t utf8_to_utf16(const char *text, size_t length, char16_t *dst) noexcept
+			{
+				auto src = reinterpret_cast<const unsigned char *>(text);
+				auto end = src + length;
+				auto start = dst;
+				while (src != end)
+				{
+					ascii_utf8_to_utf16(src, end, dst);
+					while (src != end && *src < 0x80)
+						*dst++ = *src++;
+					if (src != end)
+						dst = encode_utf16(decode_utf8(src, end), dst);
+				}
+				return static_cast<size_t>(dst - start);
+			}
+
+			// dst must have room for length code units
+			inline size_t utf8_to_utf32(const char *text, size_t length, char32_t *dst) noexcept
+			{
+				auto src = reinterpret_cast<const unsigned char *>(text);
+				auto end = src + length;
+				auto start = dst;
+				while (src != end)
+				{
+					ascii_utf8_to_utf32(src, end, dst);
+					while (src != end && *src < 0x80)
+						*dst++ = *src++;
+					if (src != end)
+						*dst++ = decode_utf8(src, end);
+				}
+				return static_cast<size_t>(dst - start);
+			}
+
+			// dst must have room for 3 * length code units
+			inline size_t utf16_to_utf8(const char16_t *src, size_t length, char *dst) noexcept
+			{
+				auto end = src + length;
+				auto start = dst;
+				while (src != end)
+				{
+					ascii_utf16_to_utf8(src, end, dst);
+					while (src != end && *src < 0x80)
+						*dst++ = static_cast<char>(*src++);
+					if (src != end)
+						dst = encode_utf8(decode_utf16(src, end), dst);
+				}
+				return static_cast<size_t>(dst - start);
+			}
+
+			// dst must have room for length code units
+			inline size_t utf16_to_utf32(const char16_t *src, size_t length, char32_t *dst) noexcept
+			{
+				auto end = src + length;
+				auto start = dst;
+				while (src != end)
+				{
+					bmp_utf16_to_utf32(src, end, dst);
+					if (src != end)
+						*dst++ = decode_utf16(src, end);
+				}
+				return static_cast<size_t>(dst - start);
+			}
+
+			// dst must have room for 4 * length code units
+			inline size_t utf32_to_utf8(const char32_t *src, size_t length, char *dst) noexcept
+			{
+				auto end = src + length;
+				auto start = dst;
+				while (src != end)
+				{
+					ascii_utf32_to_utf8(src, end, dst);
+					while (src != end && *src < 0x80)
+						*dst++ = static_cast<char>(*src++);
+					if (src != end)
+						dst = encode_utf8(validate_utf32(*src++), dst);
+				}
+				return static_cast<size_t>(dst - start);
+			}
+
+			// dst must have room for 2 * length code units
+			inline size_t utf32_to_utf16(const char32_t *src, size_t length, char16_t *dst) noexcept
+			{
+				auto end = src + length;
+				auto start = dst;
+				while (src != end)
+				{
+					bmp_utf32_to_utf16(src, end, dst);
+					if (src != end)
+						dst = encode_utf16(validate_utf32(*src++), dst);
+				}
+				return static_cast<size_t>(dst - start);
+			}
+
+			// Buffer with small inline storage for temporary conversion results
+			template<class Char, size_t InlineSize = 256>
+			class buffer
+			{
+				Char local[InlineSize];
+				std::unique_ptr<Char[]> heap;
+				Char *ptr;
+				size_t length{ 0 };
+
+			public:
+				explicit buffer(size_t capacity) :
+					ptr{ local }
+				{
+					if (capacity > InlineSize)
+					{
+						heap = std::make_unique<Char[]>(capacity);
+						ptr = heap.get();
+					}
+				}
+
+				buffer(const buffer &) = delete;
+				buffer &operator =(const buffer &) = delete;
+
+				Char *data() noexcept
+				{
+					return ptr;
+				}
+
+				const Char *data() const noexcept
+				{
+					return ptr;
+				}
+
+				size_t size() const noexcept
+				{
+					return length;
+				}
+
+				void resize(size_t size) noexcept
+				{
+					length = size;
+				}
+			};
+
+			// wide string helpers
+			inline std::wstring to_wstring(const char *text, size_t length)
+			{
+				std::wstring result(length, L'\0');
+#if defined(CBRIDGE_WCHAR_UTF16)
+				result.resize(utf8_to_utf16(text, length, reinterpret_cast<char16_t *>(&result[0])));
+#else
+				result.resize(utf8_to_utf32(text, length, reinterpret_cast<char32_t *>(&result[0])));
+#endif
+				return result;
+			}
+
+			inline std::wstring to_wstring(const char16_t *text, size_t length)
+			{
+#if defined(CBRIDGE_WCHAR_UTF16)
+				return{ reinterpret_cast<const wchar_t *>(text), length };
+#else
+				std::wstring result(length, L'\0');
+				result.resize(utf16_to_utf32(text, length, reinterpret_cast<char32_t *>(&result[0])));
+				return result;
+#endif
+			}
+
+			inline std::string to_utf8(const wchar_t *text, size_t length)
+			{
+#if defined(CBRIDGE_WCHAR_UTF16)
+				std::string result(length * 3, '\0');
+				result.resize(utf16_to_utf8(reinterpret_cast<const char16_t *>(text), length, &result[0]));
+#else
+				std::string result(length * 4, '\0');
+				result.resize(utf32_to_utf8(reinterpret_cast<const char32_t *>(text), length, &result[0]));
+#endif
+				return result;
+			}
+
+			// convert wide string to UTF-16 without allocation for short strings
+			class utf16_string
+			{
+#if defined(CBRIDGE_WCHAR_UTF16)
+				const char16_t *ptr;
+				size_t length;
+
+			public:
+				utf16_string(const wchar_t *text, size_t length) noexcept :
+					ptr{ reinterpret_cast<const char16_t *>(text) },
+					length{ length }
+				{}
+
+				const char16_t *data() const noexcept
+				{
+					return ptr;
+				}
+
+				size_t size() const noexcept
+				{
+					return length;
+				}
+#else
+				buffer<char16_t> storage;
+
+			public:
+				utf16_string(const wchar_t *text, size_t length) :
+					storage{ length * 2 }
+				{
+					storage.resize(utf32_to_utf16(reinterpret_cast<const char32_t *>(text), length, storage.data()));
+				}
+
+				const char16_t *data() const noexcept
+				{
+					return storage.data();
+				}
+
+				size_t size() const noexcept
+				{
+					return storage.size();
+				}
+#endif
+			};
+		}
+	}
+}
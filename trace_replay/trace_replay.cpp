@@ -0,0 +1,49 @@
+//-------------------------------------------------------------------------------------------------------
+// Copyright (C) 2016 HHD Software Ltd.
+// Written by Alexander Bessonov
+//
+// Licensed under the MIT license. See LICENSE.txt file in the project root for full license information.
+//-------------------------------------------------------------------------------------------------------
+
+// Replays a trace recorded by an application built with CBRIDGE_TRACE and prints time spent in each engine function
+
+#include <iostream>
+#include <iomanip>
+
+#include <chakra_bridge/chakra_trace.h>
+#pragma comment(lib,"ChakraCore")
+
+int wmain(int argc, wchar_t *argv[])
+{
+	if (argc != 2)
+	{
+		std::wcerr << L"Usage: trace_replay <trace file>" << std::endl;
+		return 2;
+	}
+
+	auto stats = jsc::trace::replay(argv[1]);
+	if (stats.empty())
+	{
+		std::wcerr << L"Unable to read trace file " << argv[1] << std::endl;
+		return 1;
+	}
+
+	std::cout << std::left << std::setw(32) << "function" << std::right
+		<< std::setw(10) << "calls"
+		<< std::setw(10) << "errors"
+		<< std::setw(14) << "replay errors"
+		<< std::setw(14) << "recorded ms"
+		<< std::setw(14) << "replayed ms" << std::endl;
+
+	std::cout << std::fixed << std::setprecision(3);
+	for (const auto &s : stats)
+	{
+		std::cout << std::left << std::setw(32) << s.name << std::right
+			<< std::setw(10) << s.calls
+			<< std::setw(10) << s.recorded_errors
+			<< std::setw(14) << s.replay_errors
+			<< std::setw(14) << s.recorded_ns / 1e6
+			<< std::setw(14) << s.replayed_ns / 1e6 << std::endl;
+	}
+	return 0;
+}